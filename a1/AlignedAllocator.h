@@ -0,0 +1,66 @@
+#ifndef ALIGNEDALLOCATOR_H
+#define ALIGNEDALLOCATOR_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#define CACHE_LINE_SIZE 64
+
+namespace RayTracer {
+	//std::vector allocator which starts every array on a cache line
+	//(over-allocates, and keeps the original pointer just before the aligned block)
+	template <typename T>
+	class AlignedAllocator {
+	public:
+		typedef T value_type;
+		typedef T* pointer;
+		typedef const T* const_pointer;
+		typedef T& reference;
+		typedef const T& const_reference;
+		typedef std::size_t size_type;
+		typedef std::ptrdiff_t difference_type;
+
+		template <typename U>
+		struct rebind {
+			typedef AlignedAllocator<U> other;
+		};
+
+		AlignedAllocator() {}
+		template <typename U>
+		AlignedAllocator(const AlignedAllocator<U>&) {}
+
+		pointer address(reference value) const { return &value; }
+		const_pointer address(const_reference value) const { return &value; }
+		size_type max_size() const { return ((size_type)-1) / sizeof(T); }
+
+		pointer allocate(size_type count, const void* = 0) {
+			void* block = std::malloc(count * sizeof(T) + CACHE_LINE_SIZE + sizeof(void*));
+			if (block == NULL)
+				throw std::bad_alloc();
+
+			std::size_t aligned = ((std::size_t)block + sizeof(void*) + CACHE_LINE_SIZE - 1) & ~(std::size_t)(CACHE_LINE_SIZE - 1);
+			((void**)aligned)[-1] = block;
+			return (pointer)aligned;
+		}
+
+		void deallocate(pointer p, size_type) {
+			if (p != NULL)
+				std::free(((void**)p)[-1]);
+		}
+
+		void construct(pointer p, const T& value) { new ((void*)p) T(value); }
+		void destroy(pointer p) { p->~T(); }
+	};
+
+	template <typename T, typename U>
+	bool operator==(const AlignedAllocator<T>&, const AlignedAllocator<U>&) { return true; }
+	template <typename T, typename U>
+	bool operator!=(const AlignedAllocator<T>&, const AlignedAllocator<U>&) { return false; }
+
+	template <typename T>
+	using AlignedArray = std::vector<T, AlignedAllocator<T> >;
+}
+
+#endif
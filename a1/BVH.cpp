@@ -0,0 +1,740 @@
+#include "BVH.h"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include "Simd.h"
+#include "SphereArray.h"
+#include "TriangleArray.h"
+#include "InstanceArray.h"
+#include "Parallel.h"
+
+using namespace RayTracer;
+using namespace Eigen;
+using namespace std;
+
+#define SAH_BINS 12
+#define SAH_TRAVERSAL_COST 1.0
+#define SAH_INTERSECT_COST 1.0
+#define MAX_LEAF_SIZE 8
+//past this depth nodes are split at their median instead, as skewed centroids can make the SAH peel off one primitive a level
+//(so the tree is at most this deep plus log2 of the primitives, which keeps it inside BVH_STACK_SIZE)
+#define MAX_SAH_DEPTH 64
+
+//morton built trees stop splitting at this many primitives
+#define MORTON_LEAF_SIZE 4
+//past this many primitives the 30 bit codes (10 bits per axis) don't separate them well enough, so 63 bit ones are used
+#define MORTON_30_BIT_LIMIT (1 << 20)
+//smallest amount of work worth giving a thread
+#define MORTON_MIN_CHUNK 16384
+
+template <typename T>
+static T surfaceArea(const Box3<T>& box) {
+	if (box.isEmpty())
+		return 0;
+	Vec3<T> d = box.sizes();
+	return 2 * (d(0) * d(1) + d(1) * d(2) + d(2) * d(0));
+}
+
+/*=======
+ * BUILD
+ *=======*/
+template <typename T>
+BVH<T>::BVH(const vector<Box3<T> >& bounds, BVHBuild build) {
+	rebuild(bounds, build);
+}
+
+//replaces the tree with one over new bounds (for primitives which have moved)
+//the node and index arrays are reused, so rebuilding every frame doesn't reallocate them
+template <typename T>
+void BVH<T>::rebuild(const vector<Box3<T> >& bounds, BVHBuild build) {
+	unsigned int i;
+
+	if (build == BVH_BUILD_MORTON) {
+		if (bounds.size() <= MORTON_30_BIT_LIMIT)
+			buildMorton<unsigned int>(bounds, 10);
+		else
+			buildMorton<unsigned long long>(bounds, 21);
+		return;
+	}
+
+	nodes.clear();
+	primIndices.clear();
+	primBounds = bounds;
+	for (i = 0; i < bounds.size(); i++) {
+		primCentroids.push_back(bounds[i].center());
+		primIndices.push_back(i);
+	}
+
+	if (bounds.size() == 0)
+		return;
+
+	nodes.reserve(bounds.size() * 2);
+	buildNode(0, bounds.size(), 0);
+
+	//only needed while building
+	primBounds.clear();
+	primCentroids.clear();
+}
+
+//builds the subtree over primIndices[start, start + count) at depth depth, returns its node index
+//splits are chosen by binning centroids along each axis and minimizing the SAH cost
+template <typename T>
+int BVH<T>::buildNode(int start, int count, int depth) {
+	int i, axis, bin;
+	int nodeIndex = nodes.size();
+	nodes.push_back(BVHNode<T>());
+
+	Box3<T> bounds;
+	Box3<T> centroidBounds;
+	for (i = start; i < start + count; i++) {
+		bounds.extend(primBounds[primIndices[i]]);
+		centroidBounds.extend(primCentroids[primIndices[i]]);
+	}
+
+	nodes[nodeIndex].bounds = bounds;
+	nodes[nodeIndex].left = nodes[nodeIndex].right = -1;
+	nodes[nodeIndex].start = start;
+	nodes[nodeIndex].count = count;
+
+	if (count == 1)
+		return nodeIndex;
+
+	if (depth >= MAX_SAH_DEPTH) {
+		if (count <= MAX_LEAF_SIZE)
+			return nodeIndex;
+
+		//halve it along the axis its centroids spread furthest on
+		Vec3<T> extent = centroidBounds.sizes();
+		int splitAxis = extent(0) > extent(1) ? (extent(0) > extent(2) ? 0 : 2) : (extent(1) > extent(2) ? 1 : 2);
+		int mid = start + count / 2;
+		nth_element(&primIndices[0] + start, &primIndices[0] + mid, &primIndices[0] + start + count, [&](int a, int b) {
+			return primCentroids[a](splitAxis) < primCentroids[b](splitAxis);
+		});
+
+		int left = buildNode(start, mid - start, depth + 1);
+		int right = buildNode(mid, start + count - mid, depth + 1);
+		nodes[nodeIndex].left = left;
+		nodes[nodeIndex].right = right;
+		nodes[nodeIndex].count = 0;
+		return nodeIndex;
+	}
+
+	//find the cheapest split over all axes
+	T leafCost = SAH_INTERSECT_COST * count;
+	T parentArea = surfaceArea(bounds);
+	T bestCost = numeric_limits<T>::max();
+	int bestAxis = -1;
+	int bestBin = -1;
+	Vec3<T> centroidExtent = centroidBounds.sizes();
+
+	for (axis = 0; axis < 3; axis++) {
+		if (centroidExtent(axis) <= 0)
+			continue;
+
+		Box3<T> binBounds[SAH_BINS];
+		int binCounts[SAH_BINS] = { 0 };
+		T binScale = SAH_BINS / centroidExtent(axis);
+
+		for (i = start; i < start + count; i++) {
+			bin = (int)((primCentroids[primIndices[i]](axis) - centroidBounds.min()(axis)) * binScale);
+			bin = min(bin, SAH_BINS - 1);
+			binCounts[bin]++;
+			binBounds[bin].extend(primBounds[primIndices[i]]);
+		}
+
+		//sweep from the right to get the area of everything right of each split plane
+		T rightArea[SAH_BINS];
+		int rightCount[SAH_BINS];
+		Box3<T> sweep;
+		int sweepCount = 0;
+		for (bin = SAH_BINS - 1; bin > 0; bin--) {
+			sweep.extend(binBounds[bin]);
+			sweepCount += binCounts[bin];
+			rightArea[bin] = surfaceArea(sweep);
+			rightCount[bin] = sweepCount;
+		}
+
+		//then from the left, evaluating the split between bin - 1 and bin
+		sweep.setEmpty();
+		sweepCount = 0;
+		for (bin = 1; bin < SAH_BINS; bin++) {
+			sweep.extend(binBounds[bin - 1]);
+			sweepCount += binCounts[bin - 1];
+			if (sweepCount == 0 || rightCount[bin] == 0)
+				continue;
+
+			T cost = SAH_TRAVERSAL_COST + SAH_INTERSECT_COST *
+				(surfaceArea(sweep) * sweepCount + rightArea[bin] * rightCount[bin]) / parentArea;
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = bin;
+			}
+		}
+	}
+
+	int mid;
+	if (bestAxis == -1) {
+		//every centroid is in the same place, there's nothing to split on
+		if (count <= MAX_LEAF_SIZE)
+			return nodeIndex;
+		mid = start + count / 2;
+	}
+	else {
+		if (bestCost >= leafCost && count <= MAX_LEAF_SIZE)
+			return nodeIndex;
+
+		T splitMin = centroidBounds.min()(bestAxis);
+		T binScale = SAH_BINS / centroidExtent(bestAxis);
+		int* middle = partition(&primIndices[0] + start, &primIndices[0] + start + count, [&](int prim) {
+			int b = (int)((primCentroids[prim](bestAxis) - splitMin) * binScale);
+			return min(b, SAH_BINS - 1) < bestBin;
+		});
+		mid = middle - &primIndices[0];
+	}
+
+	int left = buildNode(start, mid - start, depth + 1);
+	int right = buildNode(mid, start + count - mid, depth + 1);
+
+	nodes[nodeIndex].left = left;
+	nodes[nodeIndex].right = right;
+	nodes[nodeIndex].count = 0;
+
+	return nodeIndex;
+}
+
+/*===============
+ * MORTON BUILD
+ *===============*/
+
+//spreads the low bits of v out so there are two zero bits between each
+static unsigned int expandBits(unsigned int v) {
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+static unsigned long long expandBits(unsigned long long v) {
+	v &= 0x1fffff;
+	v = (v | v << 32) & 0x1f00000000ffffull;
+	v = (v | v << 16) & 0x1f0000ff0000ffull;
+	v = (v | v << 8) & 0x100f00f00f00f00full;
+	v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+	v = (v | v << 2) & 0x1249249249249249ull;
+	return v;
+}
+
+static int countLeadingZeros(unsigned long long v) {
+#ifdef _MSC_VER
+	unsigned long index;
+	return _BitScanReverse64(&index, v) ? 63 - (int)index : 64;
+#else
+	return v == 0 ? 64 : __builtin_clzll(v);
+#endif
+}
+
+//least significant digit first radix sort of the codes, carrying the primitive indices along
+//each pass histograms a chunk of the keys per thread, then every thread scatters its chunk to its own offsets
+template <typename Code>
+static void radixSort(vector<Code>* codes, vector<int>* indices) {
+	const int digitBits = 8;
+	const int buckets = 1 << digitBits;
+	int count = codes->size();
+	int chunks = chunksFor(count, MORTON_MIN_CHUNK);
+
+	vector<Code> codesOut(count);
+	vector<int> indicesOut(count);
+	vector<int> histograms(chunks * buckets);
+
+	for (int shift = 0; shift < (int)sizeof(Code) * 8; shift += digitBits) {
+		fill(histograms.begin(), histograms.end(), 0);
+
+		parallelChunks(count, chunks, [&](int chunk, int begin, int end) {
+			int* histogram = &histograms[chunk * buckets];
+			for (int i = begin; i < end; i++)
+				histogram[((*codes)[i] >> shift) & (buckets - 1)]++;
+		});
+
+		//a digit every code has in common doesn't change the order
+		bool allSame = false;
+		for (int bucket = 0; bucket < buckets && !allSame; bucket++) {
+			int total = 0;
+			for (int chunk = 0; chunk < chunks; chunk++)
+				total += histograms[chunk * buckets + bucket];
+			allSame = total == count;
+		}
+		if (allSame)
+			continue;
+
+		//turn the counts into where each chunk's run of each digit starts
+		int offset = 0;
+		for (int bucket = 0; bucket < buckets; bucket++) {
+			for (int chunk = 0; chunk < chunks; chunk++) {
+				int bucketCount = histograms[chunk * buckets + bucket];
+				histograms[chunk * buckets + bucket] = offset;
+				offset += bucketCount;
+			}
+		}
+
+		parallelChunks(count, chunks, [&](int chunk, int begin, int end) {
+			int* cursor = &histograms[chunk * buckets];
+			for (int i = begin; i < end; i++) {
+				int destination = cursor[((*codes)[i] >> shift) & (buckets - 1)]++;
+				codesOut[destination] = (*codes)[i];
+				indicesOut[destination] = (*indices)[i];
+			}
+		});
+
+		codes->swap(codesOut);
+		indices->swap(indicesOut);
+	}
+}
+
+//linear BVH (Karras, "Maximizing Parallelism in the Construction of BVHs, Octrees, and k-d Trees")
+//primitives are sorted by the Morton codes of their centroids, then every interior node is found independently
+//from the sorted codes: interior node i starts or ends at sorted position i, and splits where the highest differing bit changes
+//nodes [0, count - 1) are interior (0 is the root), [count - 1, 2 * count - 1) are the single primitive leaves
+//bounds are filled in bottom up, and ranges of MORTON_LEAF_SIZE or fewer are made leaves (what's below them is never reached)
+template <typename T>
+template <typename Code>
+void BVH<T>::buildMorton(const vector<Box3<T> >& bounds, int bitsPerAxis) {
+	int count = bounds.size();
+	int chunks = chunksFor(count, MORTON_MIN_CHUNK);
+	int chunk;
+
+	if (count == 0) {
+		nodes.clear();
+		primIndices.clear();
+		return;
+	}
+
+	primIndices.resize(count);
+	if (count == 1) {
+		primIndices[0] = 0;
+		nodes.resize(1);
+		nodes[0].bounds = bounds[0];
+		nodes[0].left = nodes[0].right = -1;
+		nodes[0].start = 0;
+		nodes[0].count = 1;
+		return;
+	}
+
+	//bounds of the centroids, to quantize them in
+	vector<Box3<T> > chunkBounds(chunks);
+	parallelChunks(count, chunks, [&](int chunk, int begin, int end) {
+		for (int i = begin; i < end; i++)
+			chunkBounds[chunk].extend(bounds[i].center());
+	});
+	Box3<T> centroidBounds;
+	for (chunk = 0; chunk < chunks; chunk++)
+		centroidBounds.extend(chunkBounds[chunk]);
+
+	Vec3<T> extent = centroidBounds.sizes();
+	T cells = (T)((1 << bitsPerAxis) - 1);
+	Vec3<T> scale;
+	for (int axis = 0; axis < 3; axis++)
+		scale(axis) = extent(axis) > 0 ? cells / extent(axis) : 0;
+
+	vector<Code> codes(count);
+	parallelChunks(count, chunks, [&](int, int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			Vec3<T> quantized = (bounds[i].center() - centroidBounds.min()).cwiseProduct(scale);
+			codes[i] = (expandBits((Code)quantized(0)) << 2) | (expandBits((Code)quantized(1)) << 1) | expandBits((Code)quantized(2));
+			primIndices[i] = i;
+		}
+	});
+
+	radixSort(&codes, &primIndices);
+
+	//how many leading bits sorted positions i and j share, with ties broken by position (so every code is unique)
+	//-1 outside the array
+	const int codeBits = sizeof(Code) * 8;
+	auto commonPrefix = [&](int i, int j) {
+		if (j < 0 || j >= count)
+			return -1;
+		if (codes[i] == codes[j])
+			return codeBits + countLeadingZeros((unsigned long long)(i ^ j)) - 32;
+		return countLeadingZeros((unsigned long long)(codes[i] ^ codes[j])) - (64 - codeBits);
+	};
+
+	int leaves = count - 1;
+	nodes.resize(2 * count - 1);
+	vector<int> parents(2 * count - 1, -1);
+
+	parallelChunks(count, chunks, [&](int, int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			BVHNode<T>& leaf = nodes[leaves + i];
+			leaf.bounds = bounds[primIndices[i]];
+			leaf.left = leaf.right = -1;
+			leaf.start = i;
+			leaf.count = 1;
+		}
+	});
+
+	parallelChunks(count - 1, chunks, [&](int, int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			//which way the node's range goes from i, towards the neighbour sharing more bits
+			int direction = commonPrefix(i, i + 1) > commonPrefix(i, i - 1) ? 1 : -1;
+			int minimumPrefix = commonPrefix(i, i - direction);
+
+			//find the other end of the range, first an upper bound then binary search
+			int maxLength = 2;
+			while (commonPrefix(i, i + maxLength * direction) > minimumPrefix)
+				maxLength *= 2;
+			int length = 0;
+			for (int step = maxLength / 2; step >= 1; step /= 2) {
+				if (commonPrefix(i, i + (length + step) * direction) > minimumPrefix)
+					length += step;
+			}
+			int j = i + length * direction;
+
+			//then the split, the last position sharing more bits with i than j does
+			int nodePrefix = commonPrefix(i, j);
+			int split = 0;
+			int step = length;
+			do {
+				step = (step + 1) / 2;
+				if (commonPrefix(i, i + (split + step) * direction) > nodePrefix)
+					split += step;
+			} while (step > 1);
+			int gamma = i + split * direction + min(direction, 0);
+
+			int first = min(i, j);
+			int last = max(i, j);
+			BVHNode<T>& node = nodes[i];
+			node.left = first == gamma ? leaves + gamma : gamma;
+			node.right = last == gamma + 1 ? leaves + gamma + 1 : gamma + 1;
+			node.start = first;
+			node.count = last - first + 1 <= MORTON_LEAF_SIZE ? last - first + 1 : 0;
+			parents[node.left] = i;
+			parents[node.right] = i;
+		}
+	});
+
+	//bounds from each leaf up, the second child to arrive at a node does its parent
+	//(so a node's bounds are only computed once both children's are done)
+	vector<atomic<int> > arrivals(count - 1);
+	for (int i = 0; i < count - 1; i++)
+		arrivals[i].store(0, memory_order_relaxed);
+
+	parallelChunks(count, chunks, [&](int, int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			int node = parents[leaves + i];
+			while (node >= 0) {
+				if (arrivals[node].fetch_add(1, memory_order_acq_rel) == 0)
+					break;
+
+				nodes[node].bounds = nodes[nodes[node].left].bounds.merged(nodes[nodes[node].right].bounds);
+				node = parents[node];
+			}
+		}
+	});
+}
+
+/*=========
+ * QUALITY
+ *=========*/
+
+//expected cost of tracing a ray through the tree, by the surface area heuristic (lower is better)
+//the chance of a ray which hits the root hitting each node is its area over the root's area
+template <typename T>
+T BVH<T>::sahCost() const {
+	if (nodes.size() == 0)
+		return 0;
+
+	T rootArea = surfaceArea(nodes[0].bounds);
+	if (rootArea <= 0)
+		return 0;
+
+	//only nodes reachable from the root count (the morton build leaves some below its leaves)
+	T cost = 0;
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const BVHNode<T>& node = nodes[stack[--stackSize]];
+		T probability = surfaceArea(node.bounds) / rootArea;
+
+		if (node.count > 0) {
+			cost += probability * SAH_INTERSECT_COST * node.count;
+		}
+		else {
+			cost += probability * SAH_TRAVERSAL_COST;
+			stack[stackSize++] = node.left;
+			stack[stackSize++] = node.right;
+		}
+	}
+
+	return cost;
+}
+
+/*===========
+ * TRAVERSAL
+ *===========*/
+
+//slab test against [tMin, tMax], gives the distance at which the ray enters the box
+template <typename T>
+bool RayTracer::intersectBox(const Box3<T>& box, const Vec3<T>& origin, const Vec3<T>& invDirection, T tMin, T tMax, T* tNear) {
+	for (int axis = 0; axis < 3; axis++) {
+		T t0 = (box.min()(axis) - origin(axis)) * invDirection(axis);
+		T t1 = (box.max()(axis) - origin(axis)) * invDirection(axis);
+		if (t0 > t1)
+			swap(t0, t1);
+		tMin = max(tMin, t0);
+		tMax = min(tMax, t1);
+		if (tMin > tMax)
+			return false;
+	}
+
+	*tNear = tMin;
+	return true;
+}
+
+//returns the index of the nearest primitive within [ray->tMin, ray->tMax], or -1
+//ray->tMax is left at the distance to that primitive
+template <typename T>
+template <typename Primitives, typename... HitDetails>
+int BVH<T>::closestIntersection(const Primitives& primitives, Ray<T>* ray, HitDetails... hitDetails) const {
+	int closest = -1;
+
+	if (nodes.size() == 0)
+		return closest;
+
+	Vec3<T> invDirection = ray->direction.cwiseInverse();
+	T tNear;
+	if (!intersectBox(nodes[0].bounds, ray->origin, invDirection, ray->tMin, ray->tMax, &tNear))
+		return closest;
+
+	//nodes to visit, with the distance at which the ray enters them
+	int stackNodes[BVH_STACK_SIZE];
+	T stackNear[BVH_STACK_SIZE];
+	int stackSize = 0;
+
+	stackNodes[stackSize] = 0;
+	stackNear[stackSize++] = tNear;
+
+	while (stackSize > 0) {
+		stackSize--;
+		if (stackNear[stackSize] > ray->tMax)
+			continue;
+
+		const BVHNode<T>& node = nodes[stackNodes[stackSize]];
+
+		if (node.count > 0) {
+			T t;
+			int primitive = primitives.intersect(*ray, node.start, node.count, &t, hitDetails...);
+			if (primitive >= 0) {
+				closest = primitive;
+				ray->tMax = t;
+			}
+			continue;
+		}
+
+		//push the far child first so the near one is visited first
+		T leftNear, rightNear;
+		bool hitLeft = intersectBox(nodes[node.left].bounds, ray->origin, invDirection, ray->tMin, ray->tMax, &leftNear);
+		bool hitRight = intersectBox(nodes[node.right].bounds, ray->origin, invDirection, ray->tMin, ray->tMax, &rightNear);
+
+		if (hitLeft && hitRight) {
+			if (leftNear < rightNear) {
+				stackNodes[stackSize] = node.right;
+				stackNear[stackSize++] = rightNear;
+				stackNodes[stackSize] = node.left;
+				stackNear[stackSize++] = leftNear;
+			}
+			else {
+				stackNodes[stackSize] = node.left;
+				stackNear[stackSize++] = leftNear;
+				stackNodes[stackSize] = node.right;
+				stackNear[stackSize++] = rightNear;
+			}
+		}
+		else if (hitLeft) {
+			stackNodes[stackSize] = node.left;
+			stackNear[stackSize++] = leftNear;
+		}
+		else if (hitRight) {
+			stackNodes[stackSize] = node.right;
+			stackNear[stackSize++] = rightNear;
+		}
+	}
+
+	return closest;
+}
+
+//whether any primitive is hit within the ray's range, for shadow rays
+//stops at the first hit found rather than looking for the closest one (which is put in hitPrimitive, if it's not NULL)
+template <typename T>
+template <typename Primitives>
+bool BVH<T>::occluded(const Primitives& primitives, const Ray<T>& ray, int* hitPrimitive) const {
+	if (nodes.size() == 0)
+		return false;
+
+	Vec3<T> invDirection = ray.direction.cwiseInverse();
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	//order doesn't matter for any hit, so this is just depth first
+	while (stackSize > 0) {
+		const BVHNode<T>& node = nodes[stack[--stackSize]];
+		T tNear;
+
+		if (!intersectBox(node.bounds, ray.origin, invDirection, ray.tMin, ray.tMax, &tNear))
+			continue;
+
+		if (node.count > 0) {
+			if (primitives.intersectsAny(ray, node.start, node.count)) {
+				//the leaf is tested all together, so which one it was takes another look (only once something's been hit)
+				if (hitPrimitive != NULL) {
+					*hitPrimitive = node.start;
+					for (int i = node.start; i < node.start + node.count; i++) {
+						if (primitives.intersectsAny(ray, i, 1)) {
+							*hitPrimitive = i;
+							break;
+						}
+					}
+				}
+				return true;
+			}
+			continue;
+		}
+
+		stack[stackSize++] = node.right;
+		stack[stackSize++] = node.left;
+	}
+
+	return false;
+}
+
+/*==================
+ * PACKET TRAVERSAL
+ *==================*/
+
+//whether any ray in the packet hits the box within its range
+//tNear is the nearest distance at which one of them enters it
+template <typename T>
+bool RayTracer::packetIntersectsBox(const Box3<T>& box, const RayPacket<T>* packet, T* tNear) {
+	typedef typename Simd<T>::Type SimdT;
+	typedef typename Simd<T>::Mask SimdMask;
+	const int width = Simd<T>::WIDTH;
+	const T far = numeric_limits<T>::max();
+
+	SimdT minX(box.min()(0)), minY(box.min()(1)), minZ(box.min()(2));
+	SimdT maxX(box.max()(0)), maxY(box.max()(1)), maxZ(box.max()(2));
+	SimdT nearest(far);
+	bool hit = false;
+
+	for (int i = 0; i < PACKET_SIZE; i += width) {
+		SimdT originX = SimdT::load(&packet->originX[i]);
+		SimdT originY = SimdT::load(&packet->originY[i]);
+		SimdT originZ = SimdT::load(&packet->originZ[i]);
+		SimdT invDirectionX = SimdT::load(&packet->invDirectionX[i]);
+		SimdT invDirectionY = SimdT::load(&packet->invDirectionY[i]);
+		SimdT invDirectionZ = SimdT::load(&packet->invDirectionZ[i]);
+
+		SimdT t0 = (minX - originX) * invDirectionX;
+		SimdT t1 = (maxX - originX) * invDirectionX;
+		SimdT enter = simdMax(SimdT::load(&packet->tMin[i]), simdMin(t0, t1));
+		SimdT exit = simdMin(SimdT::load(&packet->tMax[i]), simdMax(t0, t1));
+
+		t0 = (minY - originY) * invDirectionY;
+		t1 = (maxY - originY) * invDirectionY;
+		enter = simdMax(enter, simdMin(t0, t1));
+		exit = simdMin(exit, simdMax(t0, t1));
+
+		t0 = (minZ - originZ) * invDirectionZ;
+		t1 = (maxZ - originZ) * invDirectionZ;
+		enter = simdMax(enter, simdMin(t0, t1));
+		exit = simdMin(exit, simdMax(t0, t1));
+
+		SimdMask mask = enter <= exit;
+		if (mask.any()) {
+			hit = true;
+			nearest = simdMin(nearest, select(mask, enter, SimdT(far)));
+		}
+	}
+
+	if (hit) {
+		T lanes[width];
+		nearest.store(lanes);
+		*tNear = far;
+		for (int lane = 0; lane < width; lane++)
+			*tNear = min(*tNear, lanes[lane]);
+	}
+
+	return hit;
+}
+
+//finds the nearest primitive for every ray in the packet at once, shrinking each ray's tMax
+//nodes are visited if any of the rays hit them, rays which missed just don't find anything there
+//hitPrimitives gets the index of the primitive each ray hit (left alone for rays which hit none)
+template <typename T>
+template <typename Primitives, typename... HitDetails>
+void BVH<T>::closestIntersections(const Primitives& primitives, RayPacket<T>* packet, int* hitPrimitives, HitDetails... hitDetails) const {
+	T tNear;
+	if (nodes.size() == 0 || !packetIntersectsBox(nodes[0].bounds, packet, &tNear))
+		return;
+
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		const BVHNode<T>& node = nodes[stack[--stackSize]];
+
+		if (node.count > 0) {
+			primitives.intersectPacket(packet, node.start, node.count, hitPrimitives, hitDetails...);
+			continue;
+		}
+
+		//visit whichever child some ray reaches first
+		T leftNear, rightNear;
+		bool hitLeft = packetIntersectsBox(nodes[node.left].bounds, packet, &leftNear);
+		bool hitRight = packetIntersectsBox(nodes[node.right].bounds, packet, &rightNear);
+
+		if (hitLeft && hitRight) {
+			if (leftNear < rightNear) {
+				stack[stackSize++] = node.right;
+				stack[stackSize++] = node.left;
+			}
+			else {
+				stack[stackSize++] = node.left;
+				stack[stackSize++] = node.right;
+			}
+		}
+		else if (hitLeft) {
+			stack[stackSize++] = node.left;
+		}
+		else if (hitRight) {
+			stack[stackSize++] = node.right;
+		}
+	}
+}
+
+template class RayTracer::BVH<float>;
+template class RayTracer::BVH<double>;
+template int BVH<float>::closestIntersection(const SphereArray<float>&, Ray<float>*) const;
+template bool BVH<float>::occluded(const SphereArray<float>&, const Ray<float>&, int*) const;
+template void BVH<float>::closestIntersections(const SphereArray<float>&, RayPacket<float>*, int*) const;
+template int BVH<float>::closestIntersection(const TriangleArray<float>&, Ray<float>*) const;
+template bool BVH<float>::occluded(const TriangleArray<float>&, const Ray<float>&, int*) const;
+template void BVH<float>::closestIntersections(const TriangleArray<float>&, RayPacket<float>*, int*) const;
+template int BVH<float>::closestIntersection(const InstanceArray<float>&, Ray<float>*, int*) const;
+template bool BVH<float>::occluded(const InstanceArray<float>&, const Ray<float>&, int*) const;
+template void BVH<float>::closestIntersections(const InstanceArray<float>&, RayPacket<float>*, int*, int*) const;
+template int BVH<double>::closestIntersection(const SphereArray<double>&, Ray<double>*) const;
+template bool BVH<double>::occluded(const SphereArray<double>&, const Ray<double>&, int*) const;
+template void BVH<double>::closestIntersections(const SphereArray<double>&, RayPacket<double>*, int*) const;
+template int BVH<double>::closestIntersection(const TriangleArray<double>&, Ray<double>*) const;
+template bool BVH<double>::occluded(const TriangleArray<double>&, const Ray<double>&, int*) const;
+template void BVH<double>::closestIntersections(const TriangleArray<double>&, RayPacket<double>*, int*) const;
+template int BVH<double>::closestIntersection(const InstanceArray<double>&, Ray<double>*, int*) const;
+template bool BVH<double>::occluded(const InstanceArray<double>&, const Ray<double>&, int*) const;
+template void BVH<double>::closestIntersections(const InstanceArray<double>&, RayPacket<double>*, int*, int*) const;
+template bool RayTracer::intersectBox(const Box3<float>&, const Vec3<float>&, const Vec3<float>&, float, float, float*);
+template bool RayTracer::intersectBox(const Box3<double>&, const Vec3<double>&, const Vec3<double>&, double, double, double*);
+template bool RayTracer::packetIntersectsBox(const Box3<float>&, const RayPacket<float>*, float*);
+template bool RayTracer::packetIntersectsBox(const Box3<double>&, const RayPacket<double>*, double*);
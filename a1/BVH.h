@@ -0,0 +1,70 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <Eigen\Dense>
+#include <vector>
+#include "Ray.h"
+#include "RayPacket.h"
+
+//how many nodes the traversals' stacks hold, which both builds keep their trees shallower than
+//(a morton built tree is at most one level per code bit, plus log2 of the primitives for the ones breaking ties)
+#define BVH_STACK_SIZE 128
+
+using namespace Eigen;
+
+namespace RayTracer {
+	//a node is either interior (count == 0, with two children)
+	//or a leaf (count > 0, covering primitives [start, start + count))
+	template <typename T>
+	struct BVHNode {
+		Box3<T> bounds;
+		int left;
+		int right;
+		int start;
+		int count;
+	};
+
+	//BVH_BUILD_SAH splits each node where the surface area heuristic says is cheapest, which gives the fastest traversal
+	//BVH_BUILD_MORTON sorts the primitives along a Morton curve and builds the tree from the sorted order in parallel,
+	//which is much quicker to build (for scenes rebuilt every frame) but not as good to traverse
+	enum BVHBuild { BVH_BUILD_SAH, BVH_BUILD_MORTON };
+
+	//bounding volume hierarchy
+	//it's built from the primitives' bounds, and primIndices gives the order the primitives have to be stored in
+	//for the leaves to reference them; the traversals take the primitives stored in that order
+	//(any of the SoA arrays, they all have intersect/intersectsAny/intersectPacket over a range)
+	//anything after the usual arguments is passed through to the primitives, for hit details only some of them have
+	//(which triangle of an instance was hit)
+	template <typename T>
+	class BVH {
+	public:
+		BVH(const std::vector<Box3<T> >& bounds, BVHBuild build = BVH_BUILD_SAH);
+		void rebuild(const std::vector<Box3<T> >& bounds, BVHBuild build);
+		T sahCost() const;
+
+		template <typename Primitives, typename... HitDetails>
+		int closestIntersection(const Primitives& primitives, Ray<T>* ray, HitDetails... hitDetails) const;
+		template <typename Primitives>
+		bool occluded(const Primitives& primitives, const Ray<T>& ray, int* hitPrimitive = NULL) const;
+		template <typename Primitives, typename... HitDetails>
+		void closestIntersections(const Primitives& primitives, RayPacket<T>* packet, int* hitPrimitives, HitDetails... hitDetails) const;
+
+		std::vector<BVHNode<T> > nodes;
+		std::vector<int> primIndices;
+
+	private:
+		std::vector<Box3<T> > primBounds;
+		std::vector<Vec3<T> > primCentroids;
+
+		int buildNode(int start, int count, int depth);
+		template <typename Code>
+		void buildMorton(const std::vector<Box3<T> >& bounds, int bitsPerAxis);
+	};
+
+	template <typename T>
+	bool intersectBox(const Box3<T>& box, const Vec3<T>& origin, const Vec3<T>& invDirection, T tMin, T tMax, T* tNear);
+	template <typename T>
+	bool packetIntersectsBox(const Box3<T>& box, const RayPacket<T>* packet, T* tNear);
+}
+
+#endif
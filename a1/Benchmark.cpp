@@ -0,0 +1,686 @@
+#include "Benchmark.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "Scene.h"
+#include "Renderer.h"
+#include "Simd.h"
+
+using namespace RayTracer;
+using namespace Eigen;
+using namespace std;
+
+static Vector3d** allocateSamples(unsigned int width, unsigned int height) {
+	Vector3d** samples = new Vector3d*[width];
+	for (unsigned int i = 0; i < width; i++)
+		samples[i] = new Vector3d[height];
+	return samples;
+}
+
+static void freeSamples(Vector3d** samples, unsigned int width) {
+	for (unsigned int i = 0; i < width; i++)
+		delete[] samples[i];
+	delete[] samples;
+}
+
+int RayTracer::closestIntersectionLinear(vector<SceneObject*>* objects, const Rayd& ray, Intersectiond* intersection) {
+	Rayd nearest = ray;
+	int closest = -1;
+
+	//each hit pulls tMax in, so only nearer ones can replace it
+	for (unsigned int i = 0; i < objects->size(); i++) {
+		if ((*objects)[i]->rayIntersect(nearest, intersection)) {
+			nearest.tMax = intersection->t;
+			closest = i;
+		}
+	}
+
+	intersection->objectIndex = closest;
+	return closest;
+}
+
+bool RayTracer::checkIntersections(vector<SceneObject*>* objects, unsigned int spheres, unsigned int rays) {
+	const double tolerance = 1e-6;
+	vector<SceneObject*> checkObjects(*objects);
+	vector<SceneObject*> noLights;
+	unsigned int i;
+
+	srand(305);
+	for (i = 0; i < spheres; i++) {
+		Vector3d* position = new Vector3d(rand() % 1000 - 200, rand() % 800, rand() % 600 - 300);
+		double radius = 1 + (rand() % 1000) / 50.0;
+		checkObjects.push_back(new Sphere(position, radius, new Vector3d(255, 255, 255)));
+	}
+
+	//from all over the scene (some inside spheres) in every direction, and the same for each accelerator
+	//they stop well past the scene, as planes hit almost edge on are too far away for any two ways of finding them to agree
+	const double rayLength = 100000;
+	vector<Rayd> checkRays;
+	for (i = 0; i < rays; i++) {
+		Vector3d origin(rand() % 1600 - 400, rand() % 1200 - 100, rand() % 2000 - 1200);
+		Vector3d direction(rand() % 2001 - 1000, rand() % 2001 - 1000, rand() % 2001 - 1000);
+		if (direction.squaredNorm() == 0)
+			direction = Vector3d(0, 0, 1);
+		checkRays.push_back(Rayd(origin, direction.normalized(), 0, rayLength));
+	}
+
+	vector<Intersectiond> expected(rays);
+	for (i = 0; i < rays; i++)
+		closestIntersectionLinear(&checkObjects, checkRays[i], &expected[i]);
+
+	SphereAccelerator accelerators[] = { SPHERE_BVH, SPHERE_GRID, SPHERE_LBVH };
+	const char* acceleratorNames[] = { "SAH BVH", "grid", "Morton BVH" };
+	unsigned int mismatches = 0;
+	printf("\nintersection check, %u rays through %d objects\n", rays, (int)checkObjects.size());
+	for (int accelerator = 0; accelerator < 3; accelerator++) {
+		Scene<double> scene(&checkObjects, &noLights, accelerators[accelerator]);
+		unsigned int hits = 0, wrong = 0;
+
+		for (i = 0; i < rays; i++) {
+			Rayd ray = checkRays[i];
+			Intersectiond found;
+			scene.closestIntersection(&ray, &found);
+
+			const Intersectiond& reference = expected[i];
+			bool same = found.objectIndex == reference.objectIndex;
+			if (same && reference.objectIndex >= 0) {
+				same = fabs(found.t - reference.t) <= tolerance * max(1.0, reference.t) &&
+					(found.normal - reference.normal).norm() <= tolerance;
+				hits++;
+			}
+
+			if (!same) {
+				if (wrong < 10) {
+					printf("  MISMATCH (%s) ray %u from (%f, %f, %f) along (%f, %f, %f): object %d at t %f, expected object %d at t %f\n",
+						acceleratorNames[accelerator], i, ray.origin(0), ray.origin(1), ray.origin(2), ray.direction(0), ray.direction(1), ray.direction(2),
+						found.objectIndex, found.t, reference.objectIndex, reference.t);
+				}
+				wrong++;
+			}
+		}
+
+		printf("  %s: %u rays hit something, %u mismatches\n", acceleratorNames[accelerator], hits, wrong);
+		mismatches += wrong;
+	}
+
+	for (i = objects->size(); i < checkObjects.size(); i++) {
+		delete checkObjects[i]->position;
+		delete checkObjects[i]->colour;
+		delete checkObjects[i];
+	}
+
+	if (mismatches > 0)
+		printf("INTERSECTION CHECK FAILED: %u mismatches\n", mismatches);
+	else
+		printf("intersection check passed\n");
+	return mismatches == 0;
+}
+
+//checks index lanes starting past 2^24 (where floats stop holding every integer) and a packet whose hit indices are that big,
+//which the rays that miss must leave exactly as they were
+template <typename T>
+static unsigned int checkIndices(const char* typeName) {
+	typedef typename Simd<T>::Type SimdT;
+	typedef typename Simd<T>::Index SimdIndex;
+	const int width = Simd<T>::WIDTH;
+	const int firstIndex = (1 << 24) + 1;
+	unsigned int wrong = 0;
+	int i;
+
+	//every other lane picks up its index
+	T laneValues[width];
+	int laneIndices[width];
+	for (i = 0; i < width; i++)
+		laneValues[i] = (T)(i % 2);
+	select(SimdT::load(laneValues) >= SimdT((T)1), SimdIndex::lanes(firstIndex), SimdIndex(-1)).store(laneIndices);
+	for (i = 0; i < width; i++) {
+		int expected = i % 2 == 1 ? firstIndex + i : -1;
+		if (laneIndices[i] != expected) {
+			printf("  MISMATCH (%s) lane %d: index %d, expected %d\n", typeName, i, laneIndices[i], expected);
+			wrong++;
+		}
+	}
+
+	//a sphere in front of every other ray
+	SphereArray<T> spheres;
+	spheres.add(Vec3<T>(0, 0, 10), 1, 0, 0);
+	RayPacket<T> packet;
+	int hitSpheres[PACKET_SIZE];
+	for (i = 0; i < PACKET_SIZE; i++) {
+		packet.setRay(i, Ray<T>(Vec3<T>(i % 2 == 0 ? 0 : 5, 0, 0), Vec3<T>(0, 0, 1), 0, 100));
+		hitSpheres[i] = firstIndex + i;
+	}
+	spheres.intersectPacket(&packet, 0, 1, hitSpheres);
+	for (i = 0; i < PACKET_SIZE; i++) {
+		int expected = i % 2 == 0 ? 0 : firstIndex + i;
+		if (hitSpheres[i] != expected) {
+			printf("  MISMATCH (%s) packet ray %d: sphere %d, expected %d\n", typeName, i, hitSpheres[i], expected);
+			wrong++;
+		}
+	}
+
+	return wrong;
+}
+
+bool RayTracer::checkPrimitiveIndices() {
+	printf("\nprimitive index check\n");
+	unsigned int mismatches = checkIndices<float>("float") + checkIndices<double>("double");
+
+	if (mismatches > 0)
+		printf("PRIMITIVE INDEX CHECK FAILED: %u mismatches\n", mismatches);
+	else
+		printf("primitive index check passed\n");
+	return mismatches == 0;
+}
+
+//checks that a BVH over primitives whose centroids are spread out as unevenly as they can be (a sphere at every power of 2
+//along x) is still shallow enough for the traversal stack, and that rays along it find the same spheres as testing every one
+bool RayTracer::checkDeepBVH(unsigned int spheres) {
+	vector<Box3<double> > bounds;
+	unsigned int i;
+	for (i = 0; i < spheres; i++) {
+		double x = ldexp(1.0, i);
+		Vec3<double> extent = Vec3<double>::Constant(x / 4);
+		bounds.push_back(Box3<double>(Vec3<double>(x, 0, 0) - extent, Vec3<double>(x, 0, 0) + extent));
+	}
+
+	BVHBuild builds[] = { BVH_BUILD_SAH, BVH_BUILD_MORTON };
+	const char* buildNames[] = { "SAH", "Morton" };
+	unsigned int mismatches = 0;
+	printf("\ndeep BVH check, %u spheres a power of 2 apart\n", spheres);
+	for (int build = 0; build < 2; build++) {
+		BVH<double> bvh(bounds, builds[build]);
+		SphereArray<double> sphereArray;
+		for (i = 0; i < bvh.primIndices.size(); i++) {
+			int sphere = bvh.primIndices[i];
+			sphereArray.add(Vec3<double>(ldexp(1.0, sphere), 0, 0), ldexp(1.0, sphere) / 4, 0, sphere);
+		}
+
+		//the depth of the deepest node reachable from the root
+		int depth = 0;
+		vector<pair<int, int> > nodes(1, make_pair(0, 1));
+		while (!nodes.empty()) {
+			pair<int, int> node = nodes.back();
+			nodes.pop_back();
+			depth = max(depth, node.second);
+			if (bvh.nodes[node.first].count == 0) {
+				nodes.push_back(make_pair(bvh.nodes[node.first].left, node.second + 1));
+				nodes.push_back(make_pair(bvh.nodes[node.first].right, node.second + 1));
+			}
+		}
+		if (depth >= BVH_STACK_SIZE) {
+			printf("  MISMATCH (%s) the tree is %d deep, deeper than the traversal stack (%d)\n", buildNames[build], depth, BVH_STACK_SIZE);
+			mismatches++;
+			continue;
+		}
+
+		//from just before each sphere, both ways along x
+		unsigned int wrong = 0;
+		for (i = 0; i < spheres; i++) {
+			for (int way = -1; way <= 1; way += 2) {
+				Rayd ray(Vec3<double>(ldexp(1.0, i) - way * ldexp(1.0, i) / 2, 0, 0), Vec3<double>(way, 0, 0));
+				Rayd linearRay = ray;
+				double t;
+				int linear = sphereArray.intersect(linearRay, 0, sphereArray.size(), &t);
+				int found = bvh.closestIntersection(sphereArray, &ray);
+
+				int expectedSphere = linear >= 0 ? sphereArray.object[linear] : -1;
+				int foundSphere = found >= 0 ? sphereArray.object[found] : -1;
+				if (foundSphere != expectedSphere) {
+					if (wrong < 10)
+						printf("  MISMATCH (%s) ray %u way %d: sphere %d, expected %d\n", buildNames[build], i, way, foundSphere, expectedSphere);
+					wrong++;
+				}
+			}
+		}
+
+		printf("  %s: %d deep, %u mismatches\n", buildNames[build], depth, wrong);
+		mismatches += wrong;
+	}
+
+	if (mismatches > 0)
+		printf("DEEP BVH CHECK FAILED: %u mismatches\n", mismatches);
+	else
+		printf("deep BVH check passed\n");
+	return mismatches == 0;
+}
+
+//keeps every pixel of the image, for comparing against another one
+class BufferSink : public TileSink {
+public:
+	BufferSink(Vector3d** pixels) {
+		this->pixels = pixels;
+	}
+
+	void writeTile(unsigned int x0, unsigned int y0, unsigned int width, unsigned int height, const Vector3d* colours) {
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++)
+				pixels[x0 + x][y0 + y] = colours[y * width + x];
+		}
+	}
+
+	Vector3d** pixels;
+};
+
+//compiles the scene in T and traces it into samples, returns the time taken in seconds (tracing only)
+template <typename T>
+static double timeRender(vector<SceneObject*>* objects, vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+	unsigned int width, unsigned int height, unsigned int supersampling, int depth, Vector3d** samples) {
+	Scene<T> scene(objects, lights);
+	BufferSink sink(samples);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	renderImage(&scene, Vec3<T>(cameraPosition.cast<T>()), width, height, supersampling, false, depth, TRACE_PACKETS, 0, &sink);
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+	return chrono::duration<double>(end - start).count();
+}
+
+//colours are compared after clamping to what the image can show
+static Vector3d clampColour(const Vector3d& colour) {
+	return colour.cwiseMax(Vector3d(0, 0, 0)).cwiseMin(Vector3d(255, 255, 255));
+}
+
+void RayTracer::benchmarkPrecision(vector<SceneObject*>* objects, vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+	unsigned int width, unsigned int height, unsigned int supersampling, int depth) {
+	unsigned int x, y;
+	Vector3d** doubleSamples = allocateSamples(width, height);
+	Vector3d** floatSamples = allocateSamples(width, height);
+
+	double doubleTime = timeRender<double>(objects, lights, cameraPosition, width, height, supersampling, depth, doubleSamples);
+	double floatTime = timeRender<float>(objects, lights, cameraPosition, width, height, supersampling, depth, floatSamples);
+
+	//error of the float image, taking the double one as correct
+	double squaredError = 0;
+	double maxError = 0;
+	unsigned int differentSamples = 0;
+	for (x = 0; x < width; x++) {
+		for (y = 0; y < height; y++) {
+			Vector3d doubleColour = clampColour(doubleSamples[x][y]);
+			Vector3d floatColour = clampColour(floatSamples[x][y]);
+			Vector3d difference = (floatColour - doubleColour).cwiseAbs();
+
+			squaredError += difference.squaredNorm();
+			maxError = max(maxError, difference.maxCoeff());
+
+			//whether it would come out as a different pixel value
+			for (int channel = 0; channel < 3; channel++) {
+				if ((int)floatColour(channel) != (int)doubleColour(channel)) {
+					differentSamples++;
+					break;
+				}
+			}
+		}
+	}
+
+	double pixels = (double)width * height;
+	printf("\nprecision benchmark, %u x %u pixels\n", width, height);
+	printf("  double: %.3fs (%.0f pixels/s)\n", doubleTime, pixels / doubleTime);
+	printf("  float:  %.3fs (%.0f pixels/s), %.2fx the speed of double\n", floatTime, pixels / floatTime, doubleTime / floatTime);
+	printf("  float error: rms %.4f, max %.2f (of 255), %u pixels (%.3f%%) change value\n",
+		sqrt(squaredError / (pixels * 3)), maxError, differentSamples, 100.0 * differentSamples / pixels);
+
+	freeSamples(doubleSamples, width);
+	freeSamples(floatSamples, width);
+}
+
+void RayTracer::benchmarkBuilds(vector<SceneObject*>* objects, vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+	unsigned int width, unsigned int height, unsigned int supersampling, int depth) {
+	const int rebuilds = 5;
+	SphereAccelerator accelerators[] = { SPHERE_BVH, SPHERE_LBVH };
+	const char* names[] = { "SAH:   ", "Morton:" };
+	Vector3d** samples = allocateSamples(width, height);
+	BufferSink sink(samples);
+
+	printf("\nBVH build benchmark, %u x %u pixels\n", width, height);
+	for (int i = 0; i < 2; i++) {
+		Scene<double> scene(objects, lights, accelerators[i]);
+
+		//the way a moving scene would rebuild it every frame (the first build is left out, it allocates the arrays)
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (int rebuild = 0; rebuild < rebuilds; rebuild++)
+			scene.updateSpheres(objects);
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+		double buildTime = chrono::duration<double>(end - start).count() / rebuilds;
+
+		start = chrono::steady_clock::now();
+		renderImage(&scene, Vec3<double>(cameraPosition), width, height, supersampling, false, depth, TRACE_PACKETS, 0, &sink);
+		end = chrono::steady_clock::now();
+		double traceTime = chrono::duration<double>(end - start).count();
+
+		printf("  %s %d spheres, rebuilt in %.2fms, SAH cost %.2f, traced in %.3fs\n",
+			names[i], scene.spheres.size(), buildTime * 1000, scene.bvh->sahCost(), traceTime);
+	}
+
+	freeSamples(samples, width);
+}
+
+void RayTracer::benchmarkAdaptive(vector<SceneObject*>* objects, vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+	unsigned int width, unsigned int height, unsigned int supersampling, int depth) {
+	unsigned int x, y;
+	Scene<double> scene(objects, lights);
+	Vector3d** uniformPixels = allocateSamples(width, height);
+	Vector3d** adaptivePixels = allocateSamples(width, height);
+	BufferSink uniformSink(uniformPixels);
+	BufferSink adaptiveSink(adaptivePixels);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	long long uniformSamples = renderImage(&scene, Vec3<double>(cameraPosition), width, height, supersampling, false, depth, TRACE_PACKETS, 0, &uniformSink);
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	double uniformTime = chrono::duration<double>(end - start).count();
+
+	start = chrono::steady_clock::now();
+	long long adaptiveSamples = renderImage(&scene, Vec3<double>(cameraPosition), width, height, supersampling, true, depth, TRACE_PACKETS, 0, &adaptiveSink);
+	end = chrono::steady_clock::now();
+	double adaptiveTime = chrono::duration<double>(end - start).count();
+
+	//error of the adaptive image, taking the uniform one as correct
+	double squaredError = 0;
+	double maxError = 0;
+	unsigned int differentPixels = 0;
+	for (x = 0; x < width; x++) {
+		for (y = 0; y < height; y++) {
+			Vector3d uniformColour = clampColour(uniformPixels[x][y]);
+			Vector3d adaptiveColour = clampColour(adaptivePixels[x][y]);
+			Vector3d difference = (adaptiveColour - uniformColour).cwiseAbs();
+
+			squaredError += difference.squaredNorm();
+			maxError = max(maxError, difference.maxCoeff());
+			if (difference.maxCoeff() >= 1)
+				differentPixels++;
+		}
+	}
+
+	double pixels = (double)width * height;
+	printf("\nadaptive supersampling benchmark, %u x %u pixels, up to %u x %u samples each\n", width, height, supersampling, supersampling);
+	printf("  uniform:  %.3fs, %lld samples (%.2f per pixel)\n", uniformTime, uniformSamples, uniformSamples / pixels);
+	printf("  adaptive: %.3fs, %lld samples (%.2f per pixel), %.2fx fewer\n", adaptiveTime, adaptiveSamples, adaptiveSamples / pixels,
+		(double)uniformSamples / adaptiveSamples);
+	printf("  adaptive error: rms %.4f, max %.2f (of 255), %u pixels (%.3f%%) off by 1 or more\n",
+		sqrt(squaredError / (pixels * 3)), maxError, differentPixels, 100.0 * differentPixels / pixels);
+
+	freeSamples(uniformPixels, width);
+	freeSamples(adaptivePixels, width);
+}
+
+void RayTracer::benchmarkWavefront(vector<SceneObject*>* objects, vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+	unsigned int width, unsigned int height, unsigned int supersampling, int depth) {
+	unsigned int x, y;
+	Scene<double> scene(objects, lights);
+	Vector3d** rayPixels = allocateSamples(width, height);
+	Vector3d** wavefrontPixels = allocateSamples(width, height);
+	BufferSink raySink(rayPixels);
+	BufferSink wavefrontSink(wavefrontPixels);
+
+	printf("\nwavefront benchmark, %u x %u pixels, %u x %u samples each\n", width, height, supersampling, supersampling);
+	for (int traceDepth = depth; traceDepth <= depth * 4; traceDepth *= 2) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		renderImage(&scene, Vec3<double>(cameraPosition), width, height, supersampling, false, traceDepth, TRACE_PACKETS, 0, &raySink);
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+		double rayTime = chrono::duration<double>(end - start).count();
+
+		start = chrono::steady_clock::now();
+		renderImage(&scene, Vec3<double>(cameraPosition), width, height, supersampling, false, traceDepth, TRACE_WAVEFRONT, 0, &wavefrontSink);
+		end = chrono::steady_clock::now();
+		double wavefrontTime = chrono::duration<double>(end - start).count();
+
+		//the sums are done in a different order, so only rounding should differ
+		double maxError = 0;
+		unsigned int differentPixels = 0;
+		for (x = 0; x < width; x++) {
+			for (y = 0; y < height; y++) {
+				Vector3d difference = (clampColour(wavefrontPixels[x][y]) - clampColour(rayPixels[x][y])).cwiseAbs();
+				maxError = max(maxError, difference.maxCoeff());
+				if (difference.maxCoeff() >= 1)
+					differentPixels++;
+			}
+		}
+
+		printf("  depth %d: rays %.3fs, wavefront %.3fs (%.2fx), max difference %.4f (of 255), %u pixels off by 1 or more\n",
+			traceDepth, rayTime, wavefrontTime, rayTime / wavefrontTime, maxError, differentPixels);
+	}
+
+	freeSamples(rayPixels, width);
+	freeSamples(wavefrontPixels, width);
+}
+
+void RayTracer::benchmarkBinning(vector<SceneObject*>* objects, vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+	unsigned int width, unsigned int height, unsigned int supersampling, int depth) {
+	unsigned int i, x, y;
+	Vector3d** unbinnedPixels = allocateSamples(width, height);
+	Vector3d** binnedPixels = allocateSamples(width, height);
+	BufferSink unbinnedSink(unbinnedPixels);
+	BufferSink binnedSink(binnedPixels);
+
+	vector<double> reflectivities;
+	for (i = 0; i < objects->size(); i++)
+		reflectivities.push_back((*objects)[i]->reflectivity);
+
+	printf("\nreflection binning benchmark, %u x %u pixels, %u x %u samples each\n", width, height, supersampling, supersampling);
+	for (int mirrors = 0; mirrors < 2; mirrors++) {
+		//every sphere as reflective as sphere1, the second time
+		if (mirrors) {
+			for (i = 0; i < objects->size(); i++) {
+				if (dynamic_cast<Sphere*>((*objects)[i]) != NULL)
+					(*objects)[i]->reflectivity = 0.9;
+			}
+		}
+		Scene<double> scene(objects, lights);
+		printf("  %s\n", mirrors ? "every sphere a mirror:" : "as it is:");
+
+		for (int traceDepth = depth; traceDepth <= depth * 4; traceDepth *= 2) {
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			renderImage(&scene, Vec3<double>(cameraPosition), width, height, supersampling, false, traceDepth, TRACE_WAVEFRONT, 0, &unbinnedSink);
+			chrono::steady_clock::time_point end = chrono::steady_clock::now();
+			double unbinnedTime = chrono::duration<double>(end - start).count();
+
+			start = chrono::steady_clock::now();
+			renderImage(&scene, Vec3<double>(cameraPosition), width, height, supersampling, false, traceDepth, TRACE_BINNED_WAVEFRONT, 0, &binnedSink);
+			end = chrono::steady_clock::now();
+			double binnedTime = chrono::duration<double>(end - start).count();
+
+			unsigned int differentPixels = 0;
+			for (x = 0; x < width; x++) {
+				for (y = 0; y < height; y++) {
+					if (unbinnedPixels[x][y] != binnedPixels[x][y])
+						differentPixels++;
+				}
+			}
+
+			printf("    depth %d: unbinned %.3fs, binned %.3fs (%.2fx), %u pixels differ\n",
+				traceDepth, unbinnedTime, binnedTime, unbinnedTime / binnedTime, differentPixels);
+		}
+	}
+
+	for (i = 0; i < objects->size(); i++)
+		(*objects)[i]->reflectivity = reflectivities[i];
+
+	freeSamples(unbinnedPixels, width);
+	freeSamples(binnedPixels, width);
+}
+
+void RayTracer::benchmarkDecoupled(vector<SceneObject*>* objects, vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+	unsigned int width, unsigned int height, unsigned int supersampling, int depth) {
+	unsigned int x, y;
+	Scene<double> scene(objects, lights);
+	Vector3d** fullPixels = allocateSamples(width, height);
+	Vector3d** decoupledPixels = allocateSamples(width, height);
+	BufferSink fullSink(fullPixels);
+	BufferSink decoupledSink(decoupledPixels);
+
+	//written over by the full image
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	renderImage(&scene, Vec3<double>(cameraPosition), width, height, 1, false, depth, TRACE_PACKETS, 0, &fullSink);
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	double singleTime = chrono::duration<double>(end - start).count();
+
+	start = chrono::steady_clock::now();
+	renderImage(&scene, Vec3<double>(cameraPosition), width, height, supersampling, false, depth, TRACE_PACKETS, 0, &fullSink);
+	end = chrono::steady_clock::now();
+	double fullTime = chrono::duration<double>(end - start).count();
+
+	start = chrono::steady_clock::now();
+	renderImage(&scene, Vec3<double>(cameraPosition), width, height, supersampling, false, depth, TRACE_DECOUPLED, 0, &decoupledSink);
+	end = chrono::steady_clock::now();
+	double decoupledTime = chrono::duration<double>(end - start).count();
+
+	//error of the decoupled image, taking the fully shaded one as correct
+	double squaredError = 0;
+	double maxError = 0;
+	unsigned int differentPixels = 0;
+	for (x = 0; x < width; x++) {
+		for (y = 0; y < height; y++) {
+			Vector3d difference = (clampColour(decoupledPixels[x][y]) - clampColour(fullPixels[x][y])).cwiseAbs();
+			squaredError += difference.squaredNorm();
+			maxError = max(maxError, difference.maxCoeff());
+			if (difference.maxCoeff() >= 1)
+				differentPixels++;
+		}
+	}
+
+	double pixels = (double)width * height;
+	printf("\ndecoupled shading benchmark, %u x %u pixels, %u x %u samples each\n", width, height, supersampling, supersampling);
+	printf("  1 sample:           %.3fs\n", singleTime);
+	printf("  shading every one:  %.3fs, %.2fx the time of 1 sample\n", fullTime, fullTime / singleTime);
+	printf("  shading once a hit: %.3fs, %.2fx the time of 1 sample\n", decoupledTime, decoupledTime / singleTime);
+	printf("  decoupled error: rms %.4f, max %.2f (of 255), %u pixels (%.3f%%) off by 1 or more\n",
+		sqrt(squaredError / (pixels * 3)), maxError, differentPixels, 100.0 * differentPixels / pixels);
+
+	freeSamples(fullPixels, width);
+	freeSamples(decoupledPixels, width);
+}
+
+void RayTracer::benchmarkLightSampling(vector<SceneObject*>* objects, vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+	unsigned int width, unsigned int height, unsigned int supersampling, int depth) {
+	unsigned int x, y;
+	Scene<double> scene(objects, lights);
+	Vector3d** fullPixels = allocateSamples(width, height);
+	Vector3d** sampledPixels = allocateSamples(width, height);
+	BufferSink fullSink(fullPixels);
+	BufferSink sampledSink(sampledPixels);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	renderImage(&scene, Vec3<double>(cameraPosition), width, height, supersampling, false, depth, TRACE_PACKETS, 0, &fullSink);
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	double fullTime = chrono::duration<double>(end - start).count();
+
+	printf("\nlight sampling benchmark, %u x %u pixels, %u x %u samples each, %d lights\n", width, height, supersampling, supersampling,
+		(int)scene.lights.size());
+	printf("  every light: %.3fs\n", fullTime);
+
+	for (int lightSamples = 1; lightSamples <= 16; lightSamples *= 4) {
+		scene.lightSamples = lightSamples;
+		start = chrono::steady_clock::now();
+		renderImage(&scene, Vec3<double>(cameraPosition), width, height, supersampling, false, depth, TRACE_PACKETS, 0, &sampledSink);
+		end = chrono::steady_clock::now();
+		double sampledTime = chrono::duration<double>(end - start).count();
+
+		//error of the sampled image, taking the fully lit one as correct, and how far its average is off (it should be close to 0)
+		double squaredError = 0;
+		Vector3d bias(0, 0, 0);
+		for (x = 0; x < width; x++) {
+			for (y = 0; y < height; y++) {
+				Vector3d difference = sampledPixels[x][y] - fullPixels[x][y];
+				squaredError += difference.squaredNorm();
+				bias += difference;
+			}
+		}
+
+		double pixels = (double)width * height;
+		bias /= pixels;
+		printf("  %2d sampled:  %.3fs (%.2fx), rms error %.3f, average off by (%.3f, %.3f, %.3f)\n", lightSamples, sampledTime,
+			fullTime / sampledTime, sqrt(squaredError / (pixels * 3)), bias(0), bias(1), bias(2));
+	}
+
+	freeSamples(fullPixels, width);
+	freeSamples(sampledPixels, width);
+}
+
+void RayTracer::benchmarkLightCulling(vector<SceneObject*>* objects, vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+	unsigned int width, unsigned int height, unsigned int supersampling, int depth) {
+	unsigned int x, y;
+	Scene<double> scene(objects, lights);
+	Vector3d** fullPixels = allocateSamples(width, height);
+	Vector3d** culledPixels = allocateSamples(width, height);
+	BufferSink fullSink(fullPixels);
+	BufferSink culledSink(culledPixels);
+
+	scene.cullLights = false;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	renderImage(&scene, Vec3<double>(cameraPosition), width, height, supersampling, false, depth, TRACE_PACKETS, 0, &fullSink);
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	double fullTime = chrono::duration<double>(end - start).count();
+
+	scene.cullLights = true;
+	start = chrono::steady_clock::now();
+	renderImage(&scene, Vec3<double>(cameraPosition), width, height, supersampling, false, depth, TRACE_PACKETS, 0, &culledSink);
+	end = chrono::steady_clock::now();
+	double culledTime = chrono::duration<double>(end - start).count();
+
+	double maxError = 0;
+	for (x = 0; x < width; x++) {
+		for (y = 0; y < height; y++)
+			maxError = max(maxError, (culledPixels[x][y] - fullPixels[x][y]).cwiseAbs().maxCoeff());
+	}
+
+	printf("\nlight culling benchmark, %u x %u pixels, %u x %u samples each, %d lights (%d with a radius)\n", width, height,
+		supersampling, supersampling, (int)scene.lights.size(), (int)scene.boundedLights.size());
+	if (scene.lightGrid != NULL) {
+		int clusters = scene.lightGrid->resolution[0] * scene.lightGrid->resolution[1] * scene.lightGrid->resolution[2];
+		printf("  %d clusters, listing %.2f lights with a radius each on average\n", clusters,
+			(double)scene.lightGrid->cellItems.size() / clusters);
+	}
+	printf("  every light: %.3fs\n", fullTime);
+	printf("  culled:      %.3fs (%.2fx)\n", culledTime, fullTime / culledTime);
+	printf("  culled image off by at most %g\n", maxError);
+
+	freeSamples(fullPixels, width);
+	freeSamples(culledPixels, width);
+}
+
+void RayTracer::benchmarkShadowCache(vector<SceneObject*>* objects, vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+	unsigned int width, unsigned int height, unsigned int supersampling, int depth) {
+	unsigned int x, y;
+	Scene<double> scene(objects, lights);
+	Vector3d** fullPixels = allocateSamples(width, height);
+	Vector3d** cachedPixels = allocateSamples(width, height);
+	BufferSink fullSink(fullPixels);
+	BufferSink cachedSink(cachedPixels);
+	ShadowCacheStats stats;
+
+	printf("\nshadow cache benchmark, %u x %u pixels, %u x %u samples each, %d lights\n", width, height, supersampling, supersampling,
+		(int)scene.lights.size());
+
+	TraceMode modes[] = { TRACE_PACKETS, TRACE_WAVEFRONT };
+	const char* modeNames[] = { "packets", "wavefront" };
+	for (int mode = 0; mode < 2; mode++) {
+		scene.cacheOccluders = false;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		renderImage(&scene, Vec3<double>(cameraPosition), width, height, supersampling, false, depth, modes[mode], 0, &fullSink);
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+		double fullTime = chrono::duration<double>(end - start).count();
+
+		scene.cacheOccluders = true;
+		start = chrono::steady_clock::now();
+		renderImage(&scene, Vec3<double>(cameraPosition), width, height, supersampling, false, depth, modes[mode], 0, &cachedSink, NULL, &stats);
+		end = chrono::steady_clock::now();
+		double cachedTime = chrono::duration<double>(end - start).count();
+
+		unsigned int differentPixels = 0;
+		for (x = 0; x < width; x++) {
+			for (y = 0; y < height; y++) {
+				if (cachedPixels[x][y] != fullPixels[x][y])
+					differentPixels++;
+			}
+		}
+
+		printf("  %s:\n", modeNames[mode]);
+		printf("    searching every time: %.3fs\n", fullTime);
+		printf("    cached occluder first: %.3fs (%.2fx), %lld of %lld cached occluders hit (%.1f%%), %u pixels different\n", cachedTime,
+			fullTime / cachedTime, stats.hits, stats.tests, stats.tests > 0 ? 100.0 * stats.hits / stats.tests : 0.0, differentPixels);
+	}
+
+	freeSamples(fullPixels, width);
+	freeSamples(cachedPixels, width);
+}
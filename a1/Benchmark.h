@@ -0,0 +1,73 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <Eigen\Dense>
+#include <vector>
+#include "SceneObject.h"
+
+using namespace Eigen;
+
+namespace RayTracer {
+	//the brute force reference the accelerators are checked against: every object's rayIntersect in turn, keeping the nearest hit
+	//returns the hit object's index in objects (-1 for none)
+	int closestIntersectionLinear(std::vector<SceneObject*>* objects, const Rayd& ray, Intersectiond* intersection);
+
+	//fires rays random rays through the objects plus a field of spheres random spheres, and checks that the scene finds the same
+	//nearest hit as closestIntersectionLinear (whether there is one, what it is, its t and its normal) with each sphere accelerator
+	//prints every mismatch, and returns false if there were any
+	bool checkIntersections(std::vector<SceneObject*>* objects, unsigned int spheres, unsigned int rays);
+
+	//checks that primitive indices too big to be exact in a float come through the SIMD intersection kernels unchanged
+	//prints every mismatch, and returns false if there were any
+	bool checkPrimitiveIndices();
+
+	//builds BVHs over spheres a power of 2 apart along x (the worst case for splitting them evenly), and checks that they fit
+	//the traversal stack and find the same spheres as testing every one; prints every mismatch, and returns false if there were any
+	bool checkDeepBVH(unsigned int spheres);
+
+	//traces the scene in float and in double, and prints how long each took and how far the float image is from the double one
+	void benchmarkPrecision(std::vector<SceneObject*>* objects, std::vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+		unsigned int width, unsigned int height, unsigned int supersampling, int depth);
+
+	//builds the BVH over the spheres with each builder, and prints how long a rebuild takes, how good the tree is
+	//(its SAH cost) and how long the scene takes to trace with it
+	void benchmarkBuilds(std::vector<SceneObject*>* objects, std::vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+		unsigned int width, unsigned int height, unsigned int supersampling, int depth);
+
+	//traces the scene with every sample and with adaptive supersampling, and prints how many samples each took
+	//and how far the adaptive image is from the full one
+	void benchmarkAdaptive(std::vector<SceneObject*>* objects, std::vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+		unsigned int width, unsigned int height, unsigned int supersampling, int depth);
+
+	//traces the scene a ray at a time (with packets) and as a wavefront, at depth and deeper, and prints how long
+	//each took and how far the wavefront image is from the other
+	void benchmarkWavefront(std::vector<SceneObject*>* objects, std::vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+		unsigned int width, unsigned int height, unsigned int supersampling, int depth);
+
+	//traces the scene as a wavefront with and without its reflections binned, as it is and again with every sphere a mirror,
+	//and prints how long each took at depth and deeper (the images should be the same)
+	void benchmarkBinning(std::vector<SceneObject*>* objects, std::vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+		unsigned int width, unsigned int height, unsigned int supersampling, int depth);
+
+	//traces the scene with one sample per pixel, then supersampled shading every sample and shading once per thing hit
+	//in each pixel, and prints how long each took and how far the decoupled image is from the fully shaded one
+	void benchmarkDecoupled(std::vector<SceneObject*>* objects, std::vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+		unsigned int width, unsigned int height, unsigned int supersampling, int depth);
+
+	//traces the scene lit by every light, then with 1, 4 and 16 shadow rays a point to lights picked from the scene's light BVH,
+	//and prints how long each took and how far each sampled image is from the fully lit one
+	void benchmarkLightSampling(std::vector<SceneObject*>* objects, std::vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+		unsigned int width, unsigned int height, unsigned int supersampling, int depth);
+
+	//traces the scene visiting every light at every point, then only the ones which could reach each point's cluster, and prints
+	//how long each took, how many lights a cluster lists on average and how far apart the images are (only by rounding)
+	void benchmarkLightCulling(std::vector<SceneObject*>* objects, std::vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+		unsigned int width, unsigned int height, unsigned int supersampling, int depth);
+
+	//traces the scene searching for every shadow ray's occluder from scratch, then trying the last one which blocked that light first,
+	//and prints how long each took, how often the cached occluder was right and whether the images are the same
+	void benchmarkShadowCache(std::vector<SceneObject*>* objects, std::vector<SceneObject*>* lights, const Vector3d& cameraPosition,
+		unsigned int width, unsigned int height, unsigned int supersampling, int depth);
+}
+
+#endif
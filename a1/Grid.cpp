@@ -0,0 +1,216 @@
+#include "Grid.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace RayTracer;
+using namespace Eigen;
+using namespace std;
+
+//cells per sphere, and the most cells along any axis
+#define GRID_DENSITY 2.0
+#define GRID_MAX_RESOLUTION 512
+
+/*=======
+ * BUILD
+ *=======*/
+template <typename T>
+Grid<T>::Grid(const vector<Box3<T> >& bounds) {
+	unsigned int i;
+	int axis, x, y, z;
+
+	for (i = 0; i < bounds.size(); i++)
+		this->bounds.extend(bounds[i]);
+
+	if (bounds.size() == 0) {
+		resolution[0] = resolution[1] = resolution[2] = 0;
+		return;
+	}
+
+	//cubic cells, as many as GRID_DENSITY per sphere
+	//(flat axes are given some thickness so the volume isn't 0)
+	Vec3<T> extent = this->bounds.sizes();
+	T minimumExtent = max(extent.maxCoeff() * (T)1e-3, numeric_limits<T>::min());
+	extent = extent.cwiseMax(Vec3<T>(minimumExtent, minimumExtent, minimumExtent));
+	T cellsPerUnit = pow((T)(GRID_DENSITY * bounds.size()) / (extent(0) * extent(1) * extent(2)), (T)1 / 3);
+
+	for (axis = 0; axis < 3; axis++) {
+		resolution[axis] = (int)ceil(extent(axis) * cellsPerUnit);
+		resolution[axis] = max(1, min(resolution[axis], GRID_MAX_RESOLUTION));
+		cellSize(axis) = extent(axis) / resolution[axis];
+		inverseCellSize(axis) = 1 / cellSize(axis);
+	}
+
+	//count the boxes in each cell (offset by one, so the prefix sum gives the starts)
+	int cellCount = resolution[0] * resolution[1] * resolution[2];
+	cellStart.assign(cellCount + 1, 0);
+
+	int minCell[3], maxCell[3];
+	for (i = 0; i < bounds.size(); i++) {
+		cellRange(bounds[i], minCell, maxCell);
+		for (z = minCell[2]; z <= maxCell[2]; z++)
+			for (y = minCell[1]; y <= maxCell[1]; y++)
+				for (x = minCell[0]; x <= maxCell[0]; x++)
+					cellStart[cellIndex(x, y, z) + 1]++;
+	}
+
+	for (int cell = 0; cell < cellCount; cell++)
+		cellStart[cell + 1] += cellStart[cell];
+
+	//then fill them in, with a cursor per cell
+	vector<int> cellFill(cellStart.begin(), cellStart.end() - 1);
+	cellItems.resize(cellStart[cellCount]);
+	for (i = 0; i < bounds.size(); i++) {
+		cellRange(bounds[i], minCell, maxCell);
+		for (z = minCell[2]; z <= maxCell[2]; z++)
+			for (y = minCell[1]; y <= maxCell[1]; y++)
+				for (x = minCell[0]; x <= maxCell[0]; x++)
+					cellItems[cellFill[cellIndex(x, y, z)]++] = i;
+	}
+}
+
+template <typename T>
+int Grid<T>::cellIndex(int x, int y, int z) const {
+	return (z * resolution[1] + y) * resolution[0] + x;
+}
+
+//the cells the box overlaps, inclusive on both ends
+template <typename T>
+void Grid<T>::cellRange(const Box3<T>& box, int* minCell, int* maxCell) const {
+	for (int axis = 0; axis < 3; axis++) {
+		minCell[axis] = (int)((box.min()(axis) - bounds.min()(axis)) * inverseCellSize(axis));
+		maxCell[axis] = (int)((box.max()(axis) - bounds.min()(axis)) * inverseCellSize(axis));
+		minCell[axis] = max(0, min(minCell[axis], resolution[axis] - 1));
+		maxCell[axis] = max(0, min(maxCell[axis], resolution[axis] - 1));
+	}
+}
+
+//the cell point is in, or -1 if it's outside the grid
+template <typename T>
+int Grid<T>::cellAt(const Vec3<T>& point) const {
+	if (cellItems.size() == 0 || !bounds.contains(point))
+		return -1;
+
+	int cell[3], sameCell[3];
+	cellRange(Box3<T>(point, point), cell, sameCell);
+	return cellIndex(cell[0], cell[1], cell[2]);
+}
+
+/*===========
+ * TRAVERSAL
+ *===========*/
+
+//walks the cells along the ray in order, calling visitCell(cell, tExit) for each until it returns true
+//tExit is the distance at which the ray leaves that cell
+//(Amanatides & Woo, "A Fast Voxel Traversal Algorithm for Ray Tracing")
+template <typename T, typename Visit>
+static void walkCells(const Grid<T>& grid, const Ray<T>& ray, Visit visitCell) {
+	const T infinity = numeric_limits<T>::infinity();
+	int axis;
+
+	if (grid.cellItems.size() == 0)
+		return;
+
+	//clip the ray to the grid
+	T tEnter = ray.tMin;
+	T tLeave = ray.tMax;
+	for (axis = 0; axis < 3; axis++) {
+		T inverseDirection = 1 / ray.direction(axis);
+		T t0 = (grid.bounds.min()(axis) - ray.origin(axis)) * inverseDirection;
+		T t1 = (grid.bounds.max()(axis) - ray.origin(axis)) * inverseDirection;
+		if (t0 > t1)
+			swap(t0, t1);
+		tEnter = max(tEnter, t0);
+		tLeave = min(tLeave, t1);
+	}
+	if (!(tEnter <= tLeave))
+		return;
+
+	int cell[3], step[3];
+	T tNext[3], tDelta[3];
+	Vec3<T> entry = ray.origin + ray.direction * tEnter;
+
+	for (axis = 0; axis < 3; axis++) {
+		cell[axis] = (int)((entry(axis) - grid.bounds.min()(axis)) / grid.cellSize(axis));
+		cell[axis] = max(0, min(cell[axis], grid.resolution[axis] - 1));
+
+		if (ray.direction(axis) > 0) {
+			step[axis] = 1;
+			tNext[axis] = (grid.bounds.min()(axis) + (cell[axis] + 1) * grid.cellSize(axis) - ray.origin(axis)) / ray.direction(axis);
+			tDelta[axis] = grid.cellSize(axis) / ray.direction(axis);
+		}
+		else if (ray.direction(axis) < 0) {
+			step[axis] = -1;
+			tNext[axis] = (grid.bounds.min()(axis) + cell[axis] * grid.cellSize(axis) - ray.origin(axis)) / ray.direction(axis);
+			tDelta[axis] = -grid.cellSize(axis) / ray.direction(axis);
+		}
+		else {
+			step[axis] = 0;
+			tNext[axis] = infinity;
+			tDelta[axis] = infinity;
+		}
+	}
+
+	while (true) {
+		//the axis whose cell boundary is crossed first
+		axis = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+		T tExit = tNext[axis];
+
+		if (visitCell((cell[2] * grid.resolution[1] + cell[1]) * grid.resolution[0] + cell[0], tExit))
+			return;
+		if (tExit > tLeave)
+			return;
+
+		cell[axis] += step[axis];
+		if (cell[axis] < 0 || cell[axis] >= grid.resolution[axis])
+			return;
+		tNext[axis] += tDelta[axis];
+	}
+}
+
+//returns the index of the nearest sphere within [ray->tMin, ray->tMax], or -1
+//ray->tMax is left at the distance to that sphere
+//spheres span several cells, so a hit found in a cell may be further along, past it; the walk only stops once the
+//best hit so far is inside the cell just visited, since no later cell can have anything nearer
+template <typename T>
+int Grid<T>::closestIntersection(const SphereArray<T>& spheres, Ray<T>* ray) const {
+	int closest = -1;
+
+	walkCells(*this, *ray, [&](int cell, T tExit) {
+		for (int i = cellStart[cell]; i < cellStart[cell + 1]; i++) {
+			T t;
+			if (spheres.intersectSphere(*ray, cellItems[i], ray->tMax, &t)) {
+				closest = cellItems[i];
+				ray->tMax = t;
+			}
+		}
+		return closest >= 0 && ray->tMax <= tExit;
+	});
+
+	return closest;
+}
+
+//whether any sphere is hit within the ray's range, stopping at the first one (which is put in hitSphere, if it's not NULL)
+template <typename T>
+bool Grid<T>::occluded(const SphereArray<T>& spheres, const Ray<T>& ray, int* hitSphere) const {
+	bool hit = false;
+
+	walkCells(*this, ray, [&](int cell, T tExit) {
+		for (int i = cellStart[cell]; i < cellStart[cell + 1]; i++) {
+			T t;
+			if (spheres.intersectSphere(ray, cellItems[i], ray.tMax, &t)) {
+				if (hitSphere != NULL)
+					*hitSphere = cellItems[i];
+				hit = true;
+				break;
+			}
+		}
+		//nothing past the end of the shadow ray can block it
+		return hit || ray.tMax <= tExit;
+	});
+
+	return hit;
+}
+
+template class RayTracer::Grid<float>;
+template class RayTracer::Grid<double>;
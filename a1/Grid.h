@@ -0,0 +1,40 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <Eigen\Dense>
+#include <vector>
+#include "Ray.h"
+#include "SphereArray.h"
+
+using namespace Eigen;
+
+namespace RayTracer {
+	//uniform grid over the spheres' bounds, an alternative to the BVH for dense fields of similar sized spheres
+	//each cell lists every box it was built from which overlaps it, by index, as one flat array (cellItems[cellStart[c]] to
+	//cellItems[cellStart[c + 1] - 1]); for spheres those are the spheres' bounds, so the indices are the spheres'
+	//built with two linear passes (count, then fill), and traversed front to back with a 3D-DDA,
+	//so the first cell with a hit inside it ends the search
+	//(the scene also keeps one over the reach of its lights, to find which could light a point)
+	template <typename T>
+	class Grid {
+	public:
+		Grid(const std::vector<Box3<T> >& bounds);
+		int closestIntersection(const SphereArray<T>& spheres, Ray<T>* ray) const;
+		bool occluded(const SphereArray<T>& spheres, const Ray<T>& ray, int* hitSphere = NULL) const;
+		int cellAt(const Vec3<T>& point) const;
+
+		Box3<T> bounds;
+		int resolution[3];
+		Vec3<T> cellSize;
+		std::vector<int> cellStart;
+		std::vector<int> cellItems;
+
+	private:
+		Vec3<T> inverseCellSize;
+
+		int cellIndex(int x, int y, int z) const;
+		void cellRange(const Box3<T>& box, int* minCell, int* maxCell) const;
+	};
+}
+
+#endif
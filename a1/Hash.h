@@ -0,0 +1,29 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstring>
+
+namespace RayTracer {
+	//mixes value into hash (splitmix64's finaliser)
+	//for random choices which have to come out the same whatever thread makes them, hashed from what they're about
+	inline unsigned long long mixHash(unsigned long long hash, unsigned long long value) {
+		hash ^= value + 0x9E3779B97F4A7C15ull;
+		hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+		hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+		return hash ^ (hash >> 31);
+	}
+
+	template <typename T>
+	inline unsigned long long scalarBits(T value) {
+		unsigned long long bits = 0;
+		std::memcpy(&bits, &value, sizeof(T));
+		return bits;
+	}
+
+	//a number in [0, 1) from a hash
+	inline double hashToUnit(unsigned long long hash) {
+		return (hash >> 11) * (1.0 / 9007199254740992.0);
+	}
+}
+
+#endif
@@ -0,0 +1,130 @@
+#include "InstanceArray.h"
+
+using namespace RayTracer;
+using namespace Eigen;
+
+template <typename T>
+InstanceArray<T>::InstanceArray() {
+}
+
+template <typename T>
+InstanceArray<T>::~InstanceArray() {
+	for (unsigned int i = 0; i < meshes.size(); i++) {
+		delete meshes[i];
+		delete meshBVHs[i];
+	}
+}
+
+//takes ownership of the mesh, returns the index instances refer to it by
+template <typename T>
+int InstanceArray<T>::addMesh(TriangleArray<T>* triangles, BVH<T>* bvh) {
+	meshes.push_back(triangles);
+	meshBVHs.push_back(bvh);
+	return meshes.size() - 1;
+}
+
+template <typename T>
+void InstanceArray<T>::add(int mesh, const Transform<T, 3, Affine>& toWorld, int material, int object) {
+	Transform<T, 3, Affine> inverse = toWorld.inverse();
+
+	this->mesh.push_back(mesh);
+	this->toObject.push_back(inverse.matrix().template topRows<3>());
+	this->normalToWorld.push_back(inverse.linear().transpose());
+	this->material.push_back(material);
+	this->object.push_back(object);
+}
+
+template <typename T>
+int InstanceArray<T>::size() const {
+	return mesh.size();
+}
+
+//bounds of the mesh once it's moved by toWorld (its BVH's root box, with all 8 corners transformed)
+template <typename T>
+Box3<T> InstanceArray<T>::worldBounds(int mesh, const Transform<T, 3, Affine>& toWorld) const {
+	Box3<T> bounds;
+	if (meshBVHs[mesh]->nodes.size() == 0)
+		return bounds;
+
+	const Box3<T>& objectBounds = meshBVHs[mesh]->nodes[0].bounds;
+	for (int corner = 0; corner < 8; corner++)
+		bounds.extend(toWorld * objectBounds.corner((typename Box3<T>::CornerType)corner));
+	return bounds;
+}
+
+//scene space normal of one of the instance's triangles, not facing any particular way
+template <typename T>
+Vec3<T> InstanceArray<T>::normal(int instance, int triangle) const {
+	return (normalToWorld[instance] * meshes[mesh[instance]]->normal(triangle)).normalized();
+}
+
+template <typename T>
+Ray<T> InstanceArray<T>::toObjectSpace(int instance, const Ray<T>& ray) const {
+	const Matrix<T, 3, 4>& transform = toObject[instance];
+	return Ray<T>(transform.template leftCols<3>() * ray.origin + transform.col(3),
+		transform.template leftCols<3>() * ray.direction, ray.tMin, ray.tMax);
+}
+
+//returns the index of the nearest instance in [start, start + count) hit within the ray's range, or -1
+//t is set to the distance to it, and hitTriangle to the triangle of its mesh which was hit
+template <typename T>
+int InstanceArray<T>::intersect(const Ray<T>& ray, int start, int count, T* t, int* hitTriangle) const {
+	T bestT = ray.tMax;
+	int bestIndex = -1;
+
+	for (int i = start; i < start + count; i++) {
+		Ray<T> objectRay = toObjectSpace(i, ray);
+		objectRay.tMax = bestT;
+
+		int triangle = meshBVHs[mesh[i]]->closestIntersection(*meshes[mesh[i]], &objectRay);
+		if (triangle >= 0) {
+			bestT = objectRay.tMax;
+			bestIndex = i;
+			*hitTriangle = triangle;
+		}
+	}
+
+	*t = bestT;
+	return bestIndex;
+}
+
+template <typename T>
+bool InstanceArray<T>::intersectsAny(const Ray<T>& ray, int start, int count) const {
+	for (int i = start; i < start + count; i++) {
+		if (meshBVHs[mesh[i]]->occluded(*meshes[mesh[i]], toObjectSpace(i, ray)))
+			return true;
+	}
+
+	return false;
+}
+
+//traces the packet through instances [start, start + count), each one moving the whole packet into its object space
+//shrinks each ray's tMax and records which instance and triangle it hit
+template <typename T>
+void InstanceArray<T>::intersectPacket(RayPacket<T>* packet, int start, int count, int* hitInstances, int* hitTriangles) const {
+	int i;
+
+	for (int instance = start; instance < start + count; instance++) {
+		RayPacket<T> objectPacket;
+		int triangles[PACKET_SIZE];
+
+		for (i = 0; i < PACKET_SIZE; i++) {
+			triangles[i] = -1;
+			if (packet->isActive(i))
+				objectPacket.setRay(i, toObjectSpace(instance, packet->getRay(i)));
+		}
+
+		meshBVHs[mesh[instance]]->closestIntersections(*meshes[mesh[instance]], &objectPacket, triangles);
+
+		for (i = 0; i < PACKET_SIZE; i++) {
+			if (triangles[i] >= 0) {
+				packet->tMax[i] = objectPacket.tMax[i];
+				hitInstances[i] = instance;
+				hitTriangles[i] = triangles[i];
+			}
+		}
+	}
+}
+
+template class RayTracer::InstanceArray<float>;
+template class RayTracer::InstanceArray<double>;
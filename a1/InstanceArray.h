@@ -0,0 +1,49 @@
+#ifndef INSTANCEARRAY_H
+#define INSTANCEARRAY_H
+
+#include <Eigen\Dense>
+#include <vector>
+#include "Ray.h"
+#include "RayPacket.h"
+#include "AlignedAllocator.h"
+#include "TriangleArray.h"
+#include "BVH.h"
+
+using namespace Eigen;
+
+namespace RayTracer {
+	//the top level of the scene's meshes: each instance is a transform and a material over one of the meshes,
+	//which are stored once (with their own BVHs) however many instances use them
+	//rays are moved into the instance's object space and traced through the mesh's BVH there
+	//(the direction isn't renormalized, so distances along the ray are the same in both spaces)
+	template <typename T>
+	class InstanceArray {
+	public:
+		InstanceArray();
+		~InstanceArray();
+		int addMesh(TriangleArray<T>* triangles, BVH<T>* bvh);
+		void add(int mesh, const Transform<T, 3, Affine>& toWorld, int material, int object);
+		int size() const;
+		Box3<T> worldBounds(int mesh, const Transform<T, 3, Affine>& toWorld) const;
+		Vec3<T> normal(int instance, int triangle) const;
+		int intersect(const Ray<T>& ray, int start, int count, T* t, int* hitTriangle) const;
+		bool intersectsAny(const Ray<T>& ray, int start, int count) const;
+		void intersectPacket(RayPacket<T>* packet, int start, int count, int* hitInstances, int* hitTriangles) const;
+
+		//unique geometry, owned here
+		std::vector<TriangleArray<T>*> meshes;
+		std::vector<BVH<T>*> meshBVHs;
+
+		//per instance
+		AlignedArray<int> mesh;
+		AlignedArray<Matrix<T, 3, 4> > toObject;
+		AlignedArray<Matrix<T, 3, 3> > normalToWorld; //inverse transpose of the transform's linear part
+		AlignedArray<int> material;
+		AlignedArray<int> object; //index in the object list the scene was built from
+
+	private:
+		Ray<T> toObjectSpace(int instance, const Ray<T>& ray) const;
+	};
+}
+
+#endif
@@ -0,0 +1,551 @@
+#include "MeshLoader.h"
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace RayTracer;
+using namespace Eigen;
+using namespace std;
+
+/*=============
+ * MAPPED FILE
+ *=============*/
+
+//a whole file mapped read only into memory
+class MappedFile {
+public:
+	MappedFile() {
+		data = NULL;
+		size = 0;
+#ifdef _WIN32
+		file = INVALID_HANDLE_VALUE;
+		mapping = NULL;
+#else
+		file = -1;
+#endif
+	}
+
+	~MappedFile() {
+#ifdef _WIN32
+		if (data != NULL)
+			UnmapViewOfFile(data);
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+#else
+		if (data != NULL)
+			munmap((void*)data, size);
+		if (file >= 0)
+			close(file);
+#endif
+	}
+
+	bool open(const char* path) {
+#ifdef _WIN32
+		file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+			return false;
+		size = (size_t)fileSize.QuadPart;
+
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+			return false;
+		data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		file = ::open(path, O_RDONLY);
+		if (file < 0)
+			return false;
+
+		struct stat fileStat;
+		if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+			return false;
+		size = (size_t)fileStat.st_size;
+
+		void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (mapped == MAP_FAILED)
+			return false;
+		data = (const char*)mapped;
+
+		//it's read front to back once
+		madvise(mapped, size, MADV_SEQUENTIAL);
+#endif
+		return data != NULL;
+	}
+
+	const char* data;
+	size_t size;
+
+private:
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int file;
+#endif
+};
+
+/*=========
+ * PARSING
+ *=========*/
+
+//the mapped file isn't null terminated, so everything here stops at end
+
+static void skipSpaces(const char** p, const char* end) {
+	while (*p < end && (**p == ' ' || **p == '\t' || **p == '\r'))
+		(*p)++;
+}
+
+static void skipLine(const char** p, const char* end) {
+	const char* newline = (const char*)memchr(*p, '\n', end - *p);
+	*p = newline != NULL ? newline + 1 : end;
+}
+
+static bool atLineEnd(const char* p, const char* end) {
+	return p >= end || *p == '\n' || *p == '#';
+}
+
+static bool parseInt(const char** p, const char* end, int* value) {
+	const char* s = *p;
+	bool negative = false;
+	if (s < end && (*s == '-' || *s == '+'))
+		negative = *s++ == '-';
+	if (s >= end || *s < '0' || *s > '9')
+		return false;
+
+	int result = 0;
+	while (s < end && *s >= '0' && *s <= '9')
+		result = result * 10 + (*s++ - '0');
+
+	*value = negative ? -result : result;
+	*p = s;
+	return true;
+}
+
+//plain decimal with an optional exponent, much faster than strtod (and doesn't need a terminator)
+//keeps 18 significant digits, more than the double can hold anyway
+static bool parseDouble(const char** p, const char* end, double* value) {
+	static const double powersOfTen[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	const char* s = *p;
+	bool negative = false;
+	if (s < end && (*s == '-' || *s == '+'))
+		negative = *s++ == '-';
+
+	unsigned long long mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool anyDigits = false;
+
+	for (; s < end && *s >= '0' && *s <= '9'; s++) {
+		anyDigits = true;
+		if (digits < 18) {
+			mantissa = mantissa * 10 + (*s - '0');
+			if (mantissa != 0)
+				digits++;
+		}
+		else {
+			exponent++;
+		}
+	}
+	if (s < end && *s == '.') {
+		for (s++; s < end && *s >= '0' && *s <= '9'; s++) {
+			anyDigits = true;
+			if (digits < 18) {
+				mantissa = mantissa * 10 + (*s - '0');
+				exponent--;
+				if (mantissa != 0)
+					digits++;
+			}
+		}
+	}
+	if (!anyDigits)
+		return false;
+
+	if (s < end && (*s == 'e' || *s == 'E')) {
+		const char* exponentStart = s + 1;
+		int explicitExponent;
+		if (parseInt(&exponentStart, end, &explicitExponent)) {
+			exponent += explicitExponent;
+			s = exponentStart;
+		}
+	}
+
+	double result = (double)mantissa;
+	while (exponent > 22) {
+		result *= 1e22;
+		exponent -= 22;
+	}
+	while (exponent < -22) {
+		result /= 1e22;
+		exponent += 22;
+	}
+	result = exponent >= 0 ? result * powersOfTen[exponent] : result / powersOfTen[-exponent];
+
+	*value = negative ? -result : result;
+	*p = s;
+	return true;
+}
+
+//splits the polygon into a fan of triangles, dropping it if any index is out of range
+static void addPolygon(Mesh* mesh, const vector<int>& polygon) {
+	unsigned int i;
+	int vertexCount = mesh->vertices.size();
+	for (i = 0; i < polygon.size(); i++) {
+		if (polygon[i] < 0 || polygon[i] >= vertexCount)
+			return;
+	}
+
+	for (i = 2; i < polygon.size(); i++) {
+		mesh->triangles.push_back(polygon[0]);
+		mesh->triangles.push_back(polygon[i - 1]);
+		mesh->triangles.push_back(polygon[i]);
+	}
+}
+
+/*=====
+ * OBJ
+ *=====*/
+static bool loadObj(const char* p, const char* end, Mesh* mesh) {
+	vector<int> polygon;
+
+	while (p < end) {
+		skipSpaces(&p, end);
+
+		if (end - p > 1 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+			p++;
+			Vector3d vertex;
+			for (int axis = 0; axis < 3; axis++) {
+				skipSpaces(&p, end);
+				if (!parseDouble(&p, end, &vertex(axis))) {
+					printf("loadMesh: bad OBJ vertex\n");
+					return false;
+				}
+			}
+			mesh->vertices.push_back(vertex);
+		}
+		else if (end - p > 1 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+			p++;
+			polygon.clear();
+			while (true) {
+				skipSpaces(&p, end);
+				if (atLineEnd(p, end))
+					break;
+
+				//v, v/vt, v//vn or v/vt/vn, only the vertex matters
+				int index;
+				if (!parseInt(&p, end, &index))
+					break;
+				polygon.push_back(index > 0 ? index - 1 : (int)mesh->vertices.size() + index);
+				while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+					p++;
+			}
+			addPolygon(mesh, polygon);
+		}
+
+		skipLine(&p, end);
+	}
+
+	return true;
+}
+
+/*=====
+ * PLY
+ *=====*/
+enum PlyType { PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64, PLY_INVALID };
+enum PlyFormat { PLY_ASCII, PLY_BINARY_LITTLE_ENDIAN, PLY_BINARY_BIG_ENDIAN };
+
+struct PlyProperty {
+	string name;
+	PlyType type;
+	bool isList;
+	PlyType countType; //for lists
+};
+
+struct PlyElement {
+	string name;
+	int count;
+	vector<PlyProperty> properties;
+};
+
+static PlyType plyType(const string& name) {
+	if (name == "char" || name == "int8") return PLY_INT8;
+	if (name == "uchar" || name == "uint8") return PLY_UINT8;
+	if (name == "short" || name == "int16") return PLY_INT16;
+	if (name == "ushort" || name == "uint16") return PLY_UINT16;
+	if (name == "int" || name == "int32") return PLY_INT32;
+	if (name == "uint" || name == "uint32") return PLY_UINT32;
+	if (name == "float" || name == "float32") return PLY_FLOAT32;
+	if (name == "double" || name == "float64") return PLY_FLOAT64;
+	return PLY_INVALID;
+}
+
+static int plyTypeSize(PlyType type) {
+	static const int sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+	return sizes[type];
+}
+
+//splits a header line into its words
+static vector<string> headerWords(const char* p, const char* end) {
+	vector<string> words;
+	while (true) {
+		skipSpaces(&p, end);
+		if (p >= end || *p == '\n')
+			break;
+		const char* start = p;
+		while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+			p++;
+		words.push_back(string(start, p));
+	}
+	return words;
+}
+
+//reads one value, advancing p, returns false if the file ends first
+//swapBytes is for binary files of the other endianness to this machine
+static bool readPlyValue(const char** p, const char* end, PlyFormat format, bool swapBytes, PlyType type, double* value) {
+	if (format == PLY_ASCII) {
+		//values can be split across lines any way
+		while (*p < end && (**p == ' ' || **p == '\t' || **p == '\r' || **p == '\n'))
+			(*p)++;
+		return parseDouble(p, end, value);
+	}
+
+	int size = plyTypeSize(type);
+	if (end - *p < size)
+		return false;
+
+	unsigned char bytes[8];
+	memcpy(bytes, *p, size);
+	*p += size;
+
+	if (swapBytes) {
+		for (int i = 0; i < size / 2; i++) {
+			unsigned char swap = bytes[i];
+			bytes[i] = bytes[size - 1 - i];
+			bytes[size - 1 - i] = swap;
+		}
+	}
+
+	switch (type) {
+	case PLY_INT8: { signed char v; memcpy(&v, bytes, 1); *value = v; break; }
+	case PLY_UINT8: { unsigned char v; memcpy(&v, bytes, 1); *value = v; break; }
+	case PLY_INT16: { short v; memcpy(&v, bytes, 2); *value = v; break; }
+	case PLY_UINT16: { unsigned short v; memcpy(&v, bytes, 2); *value = v; break; }
+	case PLY_INT32: { int v; memcpy(&v, bytes, 4); *value = v; break; }
+	case PLY_UINT32: { unsigned int v; memcpy(&v, bytes, 4); *value = v; break; }
+	case PLY_FLOAT32: { float v; memcpy(&v, bytes, 4); *value = v; break; }
+	case PLY_FLOAT64: { double v; memcpy(&v, bytes, 8); *value = v; break; }
+	default: return false;
+	}
+	return true;
+}
+
+static bool loadPly(const char* p, const char* end, Mesh* mesh) {
+	vector<PlyElement> elements;
+	PlyFormat format = PLY_ASCII;
+	unsigned int i;
+	int j;
+
+	/*--- header ---*/
+	if (end - p < 3 || memcmp(p, "ply", 3) != 0) {
+		printf("loadMesh: not a PLY file\n");
+		return false;
+	}
+
+	bool headerDone = false;
+	while (p < end && !headerDone) {
+		vector<string> words = headerWords(p, end);
+		skipLine(&p, end);
+		if (words.size() == 0)
+			continue;
+
+		if (words[0] == "format" && words.size() >= 2) {
+			if (words[1] == "ascii") format = PLY_ASCII;
+			else if (words[1] == "binary_little_endian") format = PLY_BINARY_LITTLE_ENDIAN;
+			else if (words[1] == "binary_big_endian") format = PLY_BINARY_BIG_ENDIAN;
+			else {
+				printf("loadMesh: unknown PLY format %s\n", words[1].c_str());
+				return false;
+			}
+		}
+		else if (words[0] == "element" && words.size() >= 3) {
+			PlyElement element;
+			element.name = words[1];
+			element.count = atoi(words[2].c_str());
+			elements.push_back(element);
+		}
+		else if (words[0] == "property" && elements.size() > 0) {
+			PlyProperty property;
+			if (words.size() >= 5 && words[1] == "list") {
+				property.isList = true;
+				property.countType = plyType(words[2]);
+				property.type = plyType(words[3]);
+				property.name = words[4];
+			}
+			else if (words.size() >= 3) {
+				property.isList = false;
+				property.countType = PLY_INVALID;
+				property.type = plyType(words[1]);
+				property.name = words[2];
+			}
+			else {
+				continue;
+			}
+
+			if (property.type == PLY_INVALID || (property.isList && property.countType == PLY_INVALID)) {
+				printf("loadMesh: unknown PLY property type\n");
+				return false;
+			}
+			elements.back().properties.push_back(property);
+		}
+		else if (words[0] == "end_header") {
+			headerDone = true;
+		}
+	}
+
+	if (!headerDone) {
+		printf("loadMesh: PLY header never ends\n");
+		return false;
+	}
+
+	/*--- body ---*/
+	unsigned short endianProbe = 1;
+	bool littleEndianMachine = *(unsigned char*)&endianProbe == 1;
+	bool swapBytes = format != PLY_ASCII && (format == PLY_BINARY_BIG_ENDIAN) == littleEndianMachine;
+	vector<int> polygon;
+	for (i = 0; i < elements.size(); i++) {
+		const PlyElement& element = elements[i];
+		bool isVertex = element.name == "vertex";
+		bool isFace = element.name == "face";
+
+		//which properties are wanted, -1 if not present
+		int axisProperty[3] = { -1, -1, -1 };
+		int indicesProperty = -1;
+		for (j = 0; j < (int)element.properties.size(); j++) {
+			const string& name = element.properties[j].name;
+			if (isVertex && name == "x") axisProperty[0] = j;
+			if (isVertex && name == "y") axisProperty[1] = j;
+			if (isVertex && name == "z") axisProperty[2] = j;
+			if (isFace && element.properties[j].isList && (name == "vertex_indices" || name == "vertex_index"))
+				indicesProperty = j;
+		}
+
+		if (isVertex)
+			mesh->vertices.reserve(element.count);
+		if (isFace)
+			mesh->triangles.reserve(element.count * 3);
+
+		for (int item = 0; item < element.count; item++) {
+			Vector3d vertex(0, 0, 0);
+
+			for (j = 0; j < (int)element.properties.size(); j++) {
+				const PlyProperty& property = element.properties[j];
+				double value;
+
+				if (!property.isList) {
+					if (!readPlyValue(&p, end, format, swapBytes, property.type, &value)) {
+						printf("loadMesh: PLY file ends early\n");
+						return false;
+					}
+					for (int axis = 0; axis < 3; axis++) {
+						if (axisProperty[axis] == j)
+							vertex(axis) = value;
+					}
+					continue;
+				}
+
+				if (!readPlyValue(&p, end, format, swapBytes, property.countType, &value)) {
+					printf("loadMesh: PLY file ends early\n");
+					return false;
+				}
+				int count = (int)value;
+
+				if (j == indicesProperty)
+					polygon.clear();
+				for (int k = 0; k < count; k++) {
+					if (!readPlyValue(&p, end, format, swapBytes, property.type, &value)) {
+						printf("loadMesh: PLY file ends early\n");
+						return false;
+					}
+					if (j == indicesProperty)
+						polygon.push_back((int)value);
+				}
+				if (j == indicesProperty)
+					addPolygon(mesh, polygon);
+			}
+
+			if (isVertex)
+				mesh->vertices.push_back(vertex);
+		}
+	}
+
+	return true;
+}
+
+/*======
+ * LOAD
+ *======*/
+static bool hasExtension(const char* path, const char* extension) {
+	size_t pathLength = strlen(path);
+	size_t extensionLength = strlen(extension);
+	if (pathLength < extensionLength)
+		return false;
+
+	for (size_t i = 0; i < extensionLength; i++) {
+		if (tolower(path[pathLength - extensionLength + i]) != extension[i])
+			return false;
+	}
+	return true;
+}
+
+Mesh* RayTracer::loadMesh(const char* path, Vector3d* colour) {
+	bool isObj = hasExtension(path, ".obj");
+	bool isPly = hasExtension(path, ".ply");
+	if (!isObj && !isPly) {
+		printf("loadMesh: %s isn't an OBJ or PLY file\n", path);
+		return NULL;
+	}
+
+	MappedFile file;
+	if (!file.open(path)) {
+		printf("loadMesh: couldn't open %s\n", path);
+		return NULL;
+	}
+
+	Mesh* mesh = new Mesh(colour);
+	bool loaded = isObj
+		? loadObj(file.data, file.data + file.size, mesh)
+		: loadPly(file.data, file.data + file.size, mesh);
+
+	if (!loaded || mesh->triangleCount() == 0) {
+		if (loaded)
+			printf("loadMesh: %s has no triangles\n", path);
+		delete mesh;
+		return NULL;
+	}
+
+	//position is the centre of the bounds
+	AlignedBox3d bounds;
+	mesh->getBounds(&bounds);
+	*(mesh->position) = bounds.center();
+
+	return mesh;
+}
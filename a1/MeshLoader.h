@@ -0,0 +1,19 @@
+#ifndef MESHLOADER_H
+#define MESHLOADER_H
+
+#include <Eigen\Dense>
+#include "SceneObject.h"
+
+using namespace Eigen;
+
+namespace RayTracer {
+	//loads an OBJ or PLY file (chosen by extension) into a new mesh with the given colour
+	//returns NULL (after printing why) if it can't be read
+	//
+	//the file is memory mapped and parsed in place, which is much faster than going through iostreams
+	//only geometry is read: OBJ vertices and faces (any vertex/texture/normal index form, negative indices
+	//allowed), PLY vertex x/y/z and face vertex lists in ascii or binary; polygons are split into fans
+	Mesh* loadMesh(const char* path, Vector3d* colour);
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RayTracer {
+	//how many threads parallel work is split over (one per core)
+	inline int threadCount() {
+		unsigned int cores = std::thread::hardware_concurrency();
+		return cores > 0 ? (int)cores : 1;
+	}
+
+	//splits [0, count) into chunks contiguous ranges and runs body(chunk, begin, end) for each, on its own thread
+	//(the calling thread takes the first), returning once they're all done
+	//the ranges only depend on count and chunks, so two calls with the same ones line up
+	template <typename Body>
+	void parallelChunks(int count, int chunks, Body body) {
+		if (chunks <= 1) {
+			body(0, 0, count);
+			return;
+		}
+
+		std::vector<std::thread> threads;
+		for (int chunk = 1; chunk < chunks; chunk++) {
+			int begin = (int)((long long)count * chunk / chunks);
+			int end = (int)((long long)count * (chunk + 1) / chunks);
+			threads.push_back(std::thread(body, chunk, begin, end));
+		}
+
+		body(0, 0, (int)((long long)count / chunks));
+
+		for (unsigned int i = 0; i < threads.size(); i++)
+			threads[i].join();
+	}
+
+	//one thread's tasks for parallelTasks, taken from the front by the thread and from the back by the others
+	struct TaskQueue {
+		std::mutex lock;
+		std::deque<int> tasks;
+	};
+
+	//takes a task from the queue, from the back if stealing, returns false if it was empty
+	inline bool takeTask(TaskQueue* queue, bool steal, int* task) {
+		std::lock_guard<std::mutex> guard(queue->lock);
+		if (queue->tasks.empty())
+			return false;
+
+		if (steal) {
+			*task = queue->tasks.back();
+			queue->tasks.pop_back();
+		}
+		else {
+			*task = queue->tasks.front();
+			queue->tasks.pop_front();
+		}
+		return true;
+	}
+
+	//runs body(task, thread) for every task in [0, count) over threads threads (the calling thread is thread 0)
+	//for tasks which take very different amounts of time: each thread starts with a contiguous run of them and works
+	//through it in order, and once it's out it steals from the far end of another thread's run
+	//no tasks are added once it starts, so a thread which finds every queue empty is done
+	template <typename Body>
+	void parallelTasks(int count, int threads, Body body) {
+		if (threads > count)
+			threads = count;
+		if (threads <= 1) {
+			for (int task = 0; task < count; task++)
+				body(task, 0);
+			return;
+		}
+
+		std::vector<TaskQueue> queues(threads);
+		for (int thread = 0; thread < threads; thread++) {
+			int begin = (int)((long long)count * thread / threads);
+			int end = (int)((long long)count * (thread + 1) / threads);
+			for (int task = begin; task < end; task++)
+				queues[thread].tasks.push_back(task);
+		}
+
+		auto work = [&](int thread) {
+			int task;
+			while (true) {
+				if (takeTask(&queues[thread], false, &task)) {
+					body(task, thread);
+					continue;
+				}
+
+				bool stole = false;
+				for (int other = 1; other < threads && !stole; other++) {
+					if (takeTask(&queues[(thread + other) % threads], true, &task)) {
+						body(task, thread);
+						stole = true;
+					}
+				}
+				if (!stole)
+					return;
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (int thread = 1; thread < threads; thread++)
+			workers.push_back(std::thread(work, thread));
+
+		work(0);
+
+		for (unsigned int i = 0; i < workers.size(); i++)
+			workers[i].join();
+	}
+
+	//how many chunks to split count items into, so each thread gets at least minimumChunk of them
+	inline int chunksFor(int count, int minimumChunk) {
+		int chunks = count / minimumChunk;
+		if (chunks > threadCount())
+			chunks = threadCount();
+		return chunks > 1 ? chunks : 1;
+	}
+}
+
+#endif
@@ -0,0 +1,60 @@
+#include "PlaneArray.h"
+
+using namespace RayTracer;
+using namespace Eigen;
+
+template <typename T>
+PlaneArray<T>::PlaneArray() {
+}
+
+template <typename T>
+void PlaneArray<T>::add(const Vec3<T>& point, const Vec3<T>& normal, int material, int object) {
+	this->pointX.push_back(point(0));
+	this->pointY.push_back(point(1));
+	this->pointZ.push_back(point(2));
+	this->normalX.push_back(normal(0));
+	this->normalY.push_back(normal(1));
+	this->normalZ.push_back(normal(2));
+	this->material.push_back(material);
+	this->object.push_back(object);
+}
+
+template <typename T>
+int PlaneArray<T>::size() const {
+	return pointX.size();
+}
+
+//returns the index of the nearest plane hit within the ray's range, or -1
+//t is set to the distance to it
+template <typename T>
+int PlaneArray<T>::intersect(const Ray<T>& ray, T* t) const {
+	T bestT = ray.tMax;
+	int bestIndex = -1;
+
+	for (int i = 0; i < size(); i++) {
+		//dot product of the ray's direction and this plane's normal
+		T rayPlaneDot = ray.direction(0) * normalX[i] + ray.direction(1) * normalY[i] + ray.direction(2) * normalZ[i];
+		if (rayPlaneDot == 0)
+			continue; //parallel, no intersection
+
+		T hitT = ((pointX[i] - ray.origin(0)) * normalX[i]
+			+ (pointY[i] - ray.origin(1)) * normalY[i]
+			+ (pointZ[i] - ray.origin(2)) * normalZ[i]) / rayPlaneDot;
+		if (hitT >= 0 && hitT >= ray.tMin && hitT <= bestT) {
+			bestT = hitT;
+			bestIndex = i;
+		}
+	}
+
+	*t = bestT;
+	return bestIndex;
+}
+
+template <typename T>
+bool PlaneArray<T>::intersectsAny(const Ray<T>& ray) const {
+	T t;
+	return intersect(ray, &t) >= 0;
+}
+
+template class RayTracer::PlaneArray<float>;
+template class RayTracer::PlaneArray<double>;
@@ -0,0 +1,33 @@
+#ifndef PLANEARRAY_H
+#define PLANEARRAY_H
+
+#include <Eigen\Dense>
+#include "Ray.h"
+#include "AlignedAllocator.h"
+
+using namespace Eigen;
+
+namespace RayTracer {
+	//plane points and normals as structure-of-arrays
+	//planes are unbounded, so every ray tests all of them (there are only ever a few)
+	template <typename T>
+	class PlaneArray {
+	public:
+		PlaneArray();
+		void add(const Vec3<T>& point, const Vec3<T>& normal, int material, int object);
+		int size() const;
+		int intersect(const Ray<T>& ray, T* t) const;
+		bool intersectsAny(const Ray<T>& ray) const;
+
+		AlignedArray<T> pointX;
+		AlignedArray<T> pointY;
+		AlignedArray<T> pointZ;
+		AlignedArray<T> normalX;
+		AlignedArray<T> normalY;
+		AlignedArray<T> normalZ;
+		AlignedArray<int> material;
+		AlignedArray<int> object; //index in the object list the scene was built from
+	};
+}
+
+#endif
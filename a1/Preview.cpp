@@ -0,0 +1,289 @@
+#include "Preview.h"
+#include <algorithm>
+#include <cstdio>
+
+#ifdef APPLE_COMPILE
+#include <OpenGL/gl3.h>
+#define GLFW_INCLUDE_NONE
+#endif
+
+#ifdef WIN_COMPILE
+#include "glew.h"
+#endif
+
+#include "glfw3.h"
+
+using namespace RayTracer;
+using namespace Eigen;
+using namespace std;
+
+//blocks are square, in pixels
+#define PREVIEW_BLOCK 32
+
+//the same clamping as the final image
+static unsigned int quantize(double value) {
+	if (value < 0)
+		return 0;
+	if (value > 255)
+		return 255;
+	return (unsigned int)value;
+}
+
+/*=========
+ * PREVIEW
+ *=========*/
+PreviewSink::PreviewSink(unsigned int width, unsigned int height) : pixels(width * height), changed(((width + PREVIEW_BLOCK - 1) / PREVIEW_BLOCK) * ((height + PREVIEW_BLOCK - 1) / PREVIEW_BLOCK)) {
+	this->width = width;
+	this->height = height;
+	blocksX = (width + PREVIEW_BLOCK - 1) / PREVIEW_BLOCK;
+	blocksY = (height + PREVIEW_BLOCK - 1) / PREVIEW_BLOCK;
+
+	for (unsigned int i = 0; i < pixels.size(); i++)
+		pixels[i].store(0xFF000000, memory_order_relaxed);
+	for (unsigned int i = 0; i < changed.size(); i++)
+		changed[i].store(false, memory_order_relaxed);
+}
+
+//only ever called by the tracing threads
+void PreviewSink::writeTile(unsigned int x0, unsigned int y0, unsigned int width, unsigned int height, const Vector3d* colours) {
+	unsigned int x, y;
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+			const Vector3d& colour = colours[y * width + x];
+			unsigned int rgba = quantize(colour(0)) | (quantize(colour(1)) << 8) | (quantize(colour(2)) << 16) | 0xFF000000;
+			pixels[(y0 + y) * this->width + x0 + x].store(rgba, memory_order_relaxed);
+		}
+	}
+
+	//released after the pixels, so whoever sees the flag sees them
+	for (y = y0 / PREVIEW_BLOCK; y <= (y0 + height - 1) / PREVIEW_BLOCK; y++) {
+		for (x = x0 / PREVIEW_BLOCK; x <= (x0 + width - 1) / PREVIEW_BLOCK; x++)
+			changed[y * blocksX + x].store(true, memory_order_release);
+	}
+}
+
+//fills in the blocks which have changed since the last call, returns whether there were any
+bool PreviewSink::takeChanged(vector<int>* blocks) {
+	blocks->clear();
+	for (unsigned int block = 0; block < changed.size(); block++) {
+		if (changed[block].load(memory_order_relaxed) && changed[block].exchange(false, memory_order_acquire))
+			blocks->push_back(block);
+	}
+	return blocks->size() > 0;
+}
+
+void PreviewSink::blockBounds(int block, unsigned int* x0, unsigned int* y0, unsigned int* x1, unsigned int* y1) const {
+	*x0 = (block % blocksX) * PREVIEW_BLOCK;
+	*y0 = (block / blocksX) * PREVIEW_BLOCK;
+	*x1 = min(*x0 + PREVIEW_BLOCK, width);
+	*y1 = min(*y0 + PREVIEW_BLOCK, height);
+}
+
+//copies [x0, x1) x [y0, y1) out as RGBA bytes, a row at a time from the bottom
+void PreviewSink::copyRegion(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, unsigned char* rgba) const {
+	for (unsigned int y = y0; y < y1; y++) {
+		for (unsigned int x = x0; x < x1; x++) {
+			unsigned int pixel = pixels[y * width + x].load(memory_order_relaxed);
+			rgba[0] = pixel & 0xFF;
+			rgba[1] = (pixel >> 8) & 0xFF;
+			rgba[2] = (pixel >> 16) & 0xFF;
+			rgba[3] = pixel >> 24;
+			rgba += 4;
+		}
+	}
+}
+
+/*========
+ * WINDOW
+ *========*/
+static const char* previewVertexShader =
+	"#version 330 core\n"
+	"in vec2 position;\n"
+	"out vec2 uv;\n"
+	"void main() {\n"
+	"	uv = position * 0.5 + 0.5;\n"
+	"	gl_Position = vec4(position, 0.0, 1.0);\n"
+	"}\n";
+
+static const char* previewFragmentShader =
+	"#version 330 core\n"
+	"in vec2 uv;\n"
+	"out vec4 colour;\n"
+	"uniform sampler2D image;\n"
+	"void main() {\n"
+	"	colour = texture(image, uv);\n"
+	"}\n";
+
+static GLuint compileShader(GLenum type, const char* source) {
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+
+	GLint success = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	if (!success) {
+		char log[1024];
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		printf("WindowPreview: shader didn't compile:\n%s\n", log);
+	}
+	return shader;
+}
+
+//if the window can't be made (no display), the preview just doesn't show anything
+WindowPreview::WindowPreview(unsigned int width, unsigned int height, const char* title) : PreviewSink(width, height) {
+	window = NULL;
+	program = vertexArray = vertexBuffer = texture = 0;
+
+	if (!glfwInit()) {
+		printf("WindowPreview: couldn't start GLFW, there won't be a preview\n");
+		return;
+	}
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	window = glfwCreateWindow(width, height, title, NULL, NULL);
+	if (window == NULL) {
+		printf("WindowPreview: couldn't make a window, there won't be a preview\n");
+		glfwTerminate();
+		return;
+	}
+
+	glfwMakeContextCurrent(window);
+#ifdef WIN_COMPILE
+	glewExperimental = GL_TRUE;
+	glewInit();
+#endif
+	//update shouldn't wait for the screen
+	glfwSwapInterval(0);
+
+	GLuint vertexShader = compileShader(GL_VERTEX_SHADER, previewVertexShader);
+	GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, previewFragmentShader);
+	program = glCreateProgram();
+	glAttachShader(program, vertexShader);
+	glAttachShader(program, fragmentShader);
+	glLinkProgram(program);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+	glUseProgram(program);
+
+	//one quad over the whole window
+	const GLfloat corners[] = { -1, -1, 1, -1, -1, 1, 1, 1 };
+	glGenVertexArrays(1, &vertexArray);
+	glBindVertexArray(vertexArray);
+	glGenBuffers(1, &vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	GLuint position = glGetAttribLocation(program, "position");
+	glEnableVertexAttribArray(position);
+	glVertexAttribPointer(position, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+
+	//starts out black, tiles are uploaded over it as they come in
+	upload.assign(width * height * 4, 0);
+	glGenTextures(1, &texture);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &upload[0]);
+	glUniform1i(glGetUniformLocation(program, "image"), 0);
+}
+
+WindowPreview::~WindowPreview() {
+	if (window == NULL)
+		return;
+
+	glfwMakeContextCurrent(window);
+	glDeleteTextures(1, &texture);
+	glDeleteBuffers(1, &vertexBuffer);
+	glDeleteVertexArrays(1, &vertexArray);
+	glDeleteProgram(program);
+	glfwDestroyWindow(window);
+	glfwTerminate();
+}
+
+//uploads the blocks which have changed and redraws, and keeps the window responding
+//once the window's been closed, the rest of the tiles are just dropped
+void WindowPreview::update() {
+	vector<int> blocks;
+	bool anyChanged = takeChanged(&blocks);
+	if (window == NULL || glfwWindowShouldClose(window))
+		return;
+
+	glfwMakeContextCurrent(window);
+	for (unsigned int i = 0; i < blocks.size(); i++) {
+		unsigned int x0, y0, x1, y1;
+		blockBounds(blocks[i], &x0, &y0, &x1, &y1);
+		copyRegion(x0, y0, x1, y1, &upload[0]);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x0, y0, x1 - x0, y1 - y0, GL_RGBA, GL_UNSIGNED_BYTE, &upload[0]);
+	}
+
+	if (anyChanged) {
+		glClear(GL_COLOR_BUFFER_BIT);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+		glfwSwapBuffers(window);
+	}
+	glfwPollEvents();
+}
+
+/*===========
+ * SNAPSHOTS
+ *===========*/
+SnapshotPreview::SnapshotPreview(unsigned int width, unsigned int height, const char* path, double interval) : PreviewSink(width, height) {
+	this->path = path;
+	this->interval = interval;
+	lastSnapshot = chrono::steady_clock::now();
+	unsaved = false;
+}
+
+SnapshotPreview::~SnapshotPreview() {
+	vector<int> blocks;
+	if (takeChanged(&blocks) || unsaved)
+		save();
+}
+
+void SnapshotPreview::update() {
+	vector<int> blocks;
+	if (takeChanged(&blocks))
+		unsaved = true;
+
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	if (unsaved && chrono::duration<double>(now - lastSnapshot).count() >= interval)
+		save();
+}
+
+//writes the image as it is now, whether or not it's time to
+//it's written next to path then moved over it, so anything watching path never reads half a snapshot
+void SnapshotPreview::save() {
+	string partialPath = path + ".partial";
+	FILE* file = fopen(partialPath.c_str(), "wb");
+	if (file == NULL) {
+		printf("SnapshotPreview: couldn't write %s\n", partialPath.c_str());
+		return;
+	}
+
+	//PPM rows go from the top
+	vector<unsigned char> row(width * 4);
+	vector<unsigned char> rgb(width * 3);
+	fprintf(file, "P6\n%u %u\n255\n", width, height);
+	for (unsigned int y = height; y > 0; y--) {
+		copyRegion(0, y - 1, width, y, &row[0]);
+		for (unsigned int x = 0; x < width; x++) {
+			rgb[x * 3] = row[x * 4];
+			rgb[x * 3 + 1] = row[x * 4 + 1];
+			rgb[x * 3 + 2] = row[x * 4 + 2];
+		}
+		fwrite(&rgb[0], 1, rgb.size(), file);
+	}
+	fclose(file);
+
+	remove(path.c_str());
+	rename(partialPath.c_str(), path.c_str());
+
+	lastSnapshot = chrono::steady_clock::now();
+	unsaved = false;
+}
@@ -0,0 +1,74 @@
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include <Eigen\Dense>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "Renderer.h"
+
+using namespace Eigen;
+
+struct GLFWwindow;
+
+namespace RayTracer {
+	//a view of the image while it's being traced
+	//tiles (or refinement passes over them) come in on the tracing threads, and only go into an 8 bit copy of the image
+	//with no locks, so tracing never waits on the preview
+	//update shows whatever has changed since it was last called, from the thread which made the preview (as often as it likes)
+	//the image is split into blocks, and only the blocks which have changed are shown again
+	class PreviewSink : public TileSink {
+	public:
+		PreviewSink(unsigned int width, unsigned int height);
+		void writeTile(unsigned int x0, unsigned int y0, unsigned int width, unsigned int height, const Vector3d* colours);
+		virtual void update() = 0;
+
+	protected:
+		bool takeChanged(std::vector<int>* blocks);
+		void blockBounds(int block, unsigned int* x0, unsigned int* y0, unsigned int* x1, unsigned int* y1) const;
+		void copyRegion(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, unsigned char* rgba) const;
+
+		unsigned int width;
+		unsigned int height;
+		int blocksX;
+		int blocksY;
+		std::vector<std::atomic<unsigned int> > pixels; //RGBA packed into one int each, a row at a time from the bottom
+		std::vector<std::atomic<bool> > changed; //per block
+	};
+
+	//shows the image in a GLFW window, uploading only the blocks which have changed (with glTexSubImage2D)
+	//the window belongs to the thread which made it, which has to be the one calling update
+	class WindowPreview : public PreviewSink {
+	public:
+		WindowPreview(unsigned int width, unsigned int height, const char* title);
+		~WindowPreview();
+		void update();
+
+	private:
+		GLFWwindow* window;
+		unsigned int program;
+		unsigned int vertexArray;
+		unsigned int vertexBuffer;
+		unsigned int texture;
+		std::vector<unsigned char> upload;
+	};
+
+	//for machines without a display: writes the image to path (as a PPM) every interval seconds, if it's changed
+	//(and once more at the end, if it's changed since the last one)
+	class SnapshotPreview : public PreviewSink {
+	public:
+		SnapshotPreview(unsigned int width, unsigned int height, const char* path, double interval);
+		~SnapshotPreview();
+		void update();
+		void save();
+
+	private:
+		std::string path;
+		double interval;
+		std::chrono::steady_clock::time_point lastSnapshot;
+		bool unsaved;
+	};
+}
+
+#endif
@@ -3,11 +3,33 @@
 using namespace RayTracer;
 using namespace Eigen;
 
-Ray::Ray(Vector3d* origin, Vector3d* direction) {
+template <typename T>
+Ray<T>::Ray() {
+	this->tMin = 0;
+	this->tMax = std::numeric_limits<T>::max();
+}
+
+template <typename T>
+Ray<T>::Ray(const Vec3<T>& origin, const Vec3<T>& direction, T tMin, T tMax) {
 	this->origin = origin;
 	this->direction = direction;
+	this->tMin = tMin;
+	this->tMax = tMax;
+}
+
+template <>
+const float Ray<float>::epsilon = 1e-2f;
+template <>
+const double Ray<double>::epsilon = 1e-4;
+
+template <typename T>
+Intersection<T>::Intersection() {
+	this->t = std::numeric_limits<T>::max();
+	this->objectIndex = -1;
+	this->material = -1;
 }
 
-Intersection::Intersection(SceneObject* object, Vector3d* origin, Vector3d* direction) : Ray(origin, direction) {
-	this->object = object;
-}
\ No newline at end of file
+template class RayTracer::Ray<float>;
+template class RayTracer::Ray<double>;
+template class RayTracer::Intersection<float>;
+template class RayTracer::Intersection<double>;
\ No newline at end of file
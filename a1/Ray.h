@@ -2,24 +2,57 @@
 #define RAY_H
 
 #include <Eigen\Dense>
+#include <limits>
 
 using namespace Eigen;
 
 namespace RayTracer {
-	class SceneObject;
+	//the renderer core is templated on its scalar type, so it can run in float or double
+	template <typename T>
+	using Vec3 = Matrix<T, 3, 1>;
+	template <typename T>
+	using Box3 = AlignedBox<T, 3>;
 
+	//only points between tMin and tMax along the ray count as hits
+	//closest hit queries shrink tMax as they find things
+	template <typename T>
 	class Ray {
 	public:
-		Ray(Vector3d* origin, Vector3d* direction);
-		Vector3d* origin;
-		Vector3d* direction;
+		Ray();
+		Ray(const Vec3<T>& origin, const Vec3<T>& direction, T tMin = 0, T tMax = std::numeric_limits<T>::max());
+		Vec3<T> origin;
+		Vec3<T> direction;
+		T tMin;
+		T tMax;
+
+		//secondary rays start this far along, so they don't hit the surface they leave from
+		//(float needs a bigger gap than double at this scene scale)
+		static const T epsilon;
 	};
 
-	class Intersection : public Ray {
+	//filled in place by intersection tests, t is the distance along the ray
+	//objectIndex is the object's position in the scene's object list (-1 if nothing was hit)
+	//material indexes the scene's materials
+	template <typename T>
+	class Intersection {
 	public:
-		Intersection(SceneObject* object, Vector3d* origin, Vector3d* direction);
-		SceneObject* object;
+		Intersection();
+		Vec3<T> point;
+		Vec3<T> normal;
+		T t;
+		int objectIndex;
+		int material;
 	};
+
+	template <>
+	const float Ray<float>::epsilon;
+	template <>
+	const double Ray<double>::epsilon;
+
+	typedef Ray<float> Rayf;
+	typedef Ray<double> Rayd;
+	typedef Intersection<float> Intersectionf;
+	typedef Intersection<double> Intersectiond;
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "RayPacket.h"
+
+using namespace RayTracer;
+using namespace Eigen;
+
+template <typename T>
+RayPacket<T>::RayPacket() {
+	for (int i = 0; i < PACKET_SIZE; i++) {
+		originX[i] = originY[i] = originZ[i] = 0;
+		directionX[i] = directionY[i] = directionZ[i] = 1;
+		invDirectionX[i] = invDirectionY[i] = invDirectionZ[i] = 1;
+		tMin[i] = 0;
+		tMax[i] = -1;
+	}
+}
+
+template <typename T>
+void RayPacket<T>::setRay(int i, const Ray<T>& ray) {
+	originX[i] = ray.origin(0);
+	originY[i] = ray.origin(1);
+	originZ[i] = ray.origin(2);
+	directionX[i] = ray.direction(0);
+	directionY[i] = ray.direction(1);
+	directionZ[i] = ray.direction(2);
+	invDirectionX[i] = 1 / ray.direction(0);
+	invDirectionY[i] = 1 / ray.direction(1);
+	invDirectionZ[i] = 1 / ray.direction(2);
+	tMin[i] = ray.tMin;
+	tMax[i] = ray.tMax;
+}
+
+template <typename T>
+Ray<T> RayPacket<T>::getRay(int i) const {
+	return Ray<T>(Vec3<T>(originX[i], originY[i], originZ[i]), Vec3<T>(directionX[i], directionY[i], directionZ[i]), tMin[i], tMax[i]);
+}
+
+template <typename T>
+bool RayPacket<T>::isActive(int i) const {
+	return tMax[i] >= tMin[i];
+}
+
+template class RayTracer::RayPacket<float>;
+template class RayTracer::RayPacket<double>;
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef RAYPACKET_H
+#define RAYPACKET_H
+
+#include "Ray.h"
+
+//primary rays are traced in square blocks of this many pixels on a side
+#define PACKET_WIDTH 4
+#define PACKET_SIZE (PACKET_WIDTH * PACKET_WIDTH)
+
+namespace RayTracer {
+	//a block of nearly parallel rays as structure-of-arrays, so each object's setup is shared by all of them
+	//and the rays fill the SIMD lanes; unused slots have tMax < tMin, so they never hit anything
+	template <typename T>
+	class RayPacket {
+	public:
+		RayPacket();
+		void setRay(int i, const Ray<T>& ray);
+		Ray<T> getRay(int i) const;
+		bool isActive(int i) const;
+
+		T originX[PACKET_SIZE];
+		T originY[PACKET_SIZE];
+		T originZ[PACKET_SIZE];
+		T directionX[PACKET_SIZE];
+		T directionY[PACKET_SIZE];
+		T directionZ[PACKET_SIZE];
+		T invDirectionX[PACKET_SIZE];
+		T invDirectionY[PACKET_SIZE];
+		T invDirectionZ[PACKET_SIZE];
+		T tMin[PACKET_SIZE];
+		T tMax[PACKET_SIZE];
+	};
+}
+
+#endif
\ No newline at end of file
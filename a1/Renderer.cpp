@@ -0,0 +1,649 @@
+#include "Renderer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include "RayPacket.h"
+#include "Parallel.h"
+#include "Hash.h"
+#include "Wavefront.h"
+
+using namespace RayTracer;
+using namespace Eigen;
+using namespace std;
+
+//tiles are square, in pixels
+#define TILE_SIZE 32
+//how far apart (of 255) neighbouring pixels' colours have to be for adaptive supersampling to refine them
+#define ADAPTIVE_THRESHOLD 4
+//progressive rendering's first pass traces every PROGRESSIVE_STRIDE'th pixel each way, and each pass after halves it
+//(TILE_SIZE has to be a multiple of it)
+#define PROGRESSIVE_STRIDE 16
+#define PROGRESSIVE_PASSES 5
+//reflections which would carry less than this (of their colour, in any channel) to the sample are russian rouletted
+#define ROULETTE_THRESHOLD 0.05
+
+template <typename T>
+Vec3<T> RayTracer::traceRay(Ray<T>* ray, const Scene<T>* scene, int remainingDepth, const Vec3<T>& throughput, ShadowCache<T>* shadowCache) {
+	Vec3<T> backgroundColour(0, 0, 0);
+
+	/*Vector3d RED(255, 0, 0);
+	Vector3d GREEN(0, 255, 0);
+	Vector3d BLUE(255, 0, 255);
+	Vector3d YELLOW(255, 255, 0);
+	Vector3d CYAN(0, 255, 255);
+	Vector3d MAJENTA(255, 0, 255);*/
+
+	if (remainingDepth <= 0)
+		return backgroundColour;
+
+	Intersection<T> closestIntersection;
+	scene->closestIntersection(ray, &closestIntersection);
+	return shadeIntersection(ray, &closestIntersection, scene, remainingDepth, throughput, shadowCache);
+}
+
+//colour seen along the ray, given what it hit (if anything)
+template <typename T>
+Vec3<T> RayTracer::shadeIntersection(Ray<T>* ray, Intersection<T>* intersection, const Scene<T>* scene, int remainingDepth,
+	const Vec3<T>& throughput, ShadowCache<T>* shadowCache) {
+	Vec3<T> backgroundColour(0, 0, 0);
+	Vec3<T> ambientLight(25, 25, 25);
+	Intersection<T>& closestIntersection = *intersection;
+
+	if (closestIntersection.objectIndex >= 0) {
+		const Material<T>& material = scene->materials[closestIntersection.material];
+		Vec3<T> fullLightColour = ambientLight;
+		Vec3<T> surfaceColour = material.colour;
+
+		//for each light which could reach this point (or each of the ones picked), add it to the full light on it (if not blocked)
+		int cluster = scene->lightCluster(closestIntersection.point);
+		int shadowRays = scene->shadowRays(cluster);
+		for (int shadowRay = 0; shadowRay < shadowRays; shadowRay++) {
+			T weight;
+			int lightNum = scene->shadowRayLight(closestIntersection.point, closestIntersection.normal, cluster, shadowRay, &weight);
+			if (lightNum < 0)
+				continue;
+
+			const Light<T>& light = scene->lights[lightNum];
+			Vec3<T> toLight = light.position - closestIntersection.point;
+			Vec3<T> toLightNormalized = toLight.normalized();
+			T dot = toLightNormalized.dot(closestIntersection.normal);
+			T falloff = light.falloff(toLight.squaredNorm());
+
+			if (dot > 0 && falloff > 0) {
+				//only things between the point and the light can block it
+				bool inLight = !scene->occluded(closestIntersection.point, toLightNormalized, toLight.norm(), lightNum, shadowCache);
+
+				if (inLight) {
+					fullLightColour += light.colour * (dot * weight * falloff);
+				}
+			}
+		}
+
+		T reflectivity = material.reflectivity;
+		if (reflectivity > 0) {
+			Vec3<T> rayDirection = ray->direction;
+			Vec3<T> normal = closestIntersection.normal;
+			Vec3<T> reflectedDirection = rayDirection - ((2 * (normal.dot(rayDirection))) * normal);
+			Ray<T> reflectedRay(closestIntersection.point, reflectedDirection, Ray<T>::epsilon);
+
+			//faint reflections (after a few dark or dull bounces) are mostly skipped, and the rest count for more
+			Vec3<T> reflectionThroughput = throughput.cwiseProduct(fullLightColour) * (reflectivity / 255);
+			Vec3<T> reflectionColour = backgroundColour;
+			T weight;
+			if (continuePath(reflectedRay, reflectionThroughput.maxCoeff(), &weight))
+				reflectionColour = traceRay(&reflectedRay, scene, remainingDepth - 1, (Vec3<T>)(reflectionThroughput * weight), shadowCache) * weight;
+
+			surfaceColour *= 1 - reflectivity;
+			surfaceColour += reflectionColour * reflectivity;
+		}
+
+		Vec3<T> endColour = surfaceColour;
+		endColour[0] *= fullLightColour[0] / 255;
+		endColour[1] *= fullLightColour[1] / 255;
+		endColour[2] *= fullLightColour[2] / 255;
+
+		return endColour;
+	}
+	else {
+		return backgroundColour;
+	}
+}
+
+//the first reflection from a sample carries at least reflectivity * 25 / 255 (the ambient light's share),
+//so only the first reflections off dull surfaces (reflectivity under about 0.5) can be rouletted
+template <typename T>
+bool RayTracer::continuePath(const Ray<T>& ray, T throughput, T* weight) {
+	*weight = 1;
+	if (throughput >= ROULETTE_THRESHOLD || throughput <= 0)
+		return throughput > 0;
+
+	unsigned long long hash = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		hash = mixHash(hash, scalarBits(ray.origin(axis)));
+		hash = mixHash(hash, scalarBits(ray.direction(axis)));
+	}
+
+	//kept with probability throughput / ROULETTE_THRESHOLD, so the ones kept count for ROULETTE_THRESHOLD / throughput
+	T survival = throughput / (T)ROULETTE_THRESHOLD;
+	if ((T)hashToUnit(hash) >= survival)
+		return false;
+
+	*weight = 1 / survival;
+	return true;
+}
+
+//the ray through (supersampled) pixel x, y
+template <typename T>
+Ray<T> RayTracer::primaryRay(unsigned int x, unsigned int y, unsigned int supersampling, const Vec3<T>& cameraPosition) {
+	Vec3<T> rayOrigin;
+	rayOrigin = Vec3<T>(x / (T)supersampling, y / (T)supersampling, 0);
+
+	Vec3<T> rayDirection = (rayOrigin - cameraPosition).normalized();
+	return Ray<T>(rayOrigin, rayDirection);
+}
+
+//a sample to trace: where it is in the supersampled image, and where its colour goes
+struct Sample {
+	unsigned int x;
+	unsigned int y;
+	int index;
+};
+
+//something a pixel's samples hit, and the colour it was shaded, for TRACE_DECOUPLED
+//next is the next thing hit in the same pixel (-1 for none)
+struct ShadedHit {
+	int object;
+	Vector3d colour;
+	int next;
+};
+
+//traces each sample, writing its colour to colours[sample.index] and what it hit to objects[sample.index]
+//in every mode but TRACE_RAYS, the primaries are traced PACKET_SIZE at a time in the order given,
+//so neighbouring samples should be listed together
+//TRACE_DECOUPLED shades each pixel's samples once for each thing they hit (the first of them to hit it), and shares the colour
+//a pixel's samples can be spread over more than one call (like adaptive's first sample and the rest), each is shaded separately
+//wavefront is only used by the wavefront modes (one per thread, so its queues are kept from one call to the next)
+//shadowCache is the thread's too, for every mode
+template <typename T>
+static void traceSamples(const Scene<T>* scene, const Vec3<T>& cameraPosition, unsigned int supersampling, int depth, TraceMode traceMode,
+	Wavefront<T>* wavefront, ShadowCache<T>* shadowCache, const vector<Sample>& samples, Vector3d* colours, int* objects) {
+	int count = samples.size();
+	if (count == 0)
+		return;
+
+	if (traceMode == TRACE_WAVEFRONT || traceMode == TRACE_BINNED_WAVEFRONT) {
+		wavefront->primaries.clear();
+		wavefront->indices.clear();
+		for (int i = 0; i < count; i++) {
+			wavefront->primaries.push(primaryRay(samples[i].x, samples[i].y, supersampling, cameraPosition), i, Vec3<T>(1, 1, 1));
+			wavefront->indices.push_back(samples[i].index);
+		}
+
+		wavefront->trace(true, depth, shadowCache, colours, objects);
+	}
+	else if (traceMode == TRACE_DECOUPLED) {
+		vector<Ray<T> > rays(count);
+		vector<Intersection<T> > intersections(count);
+		int i;
+
+		for (int first = 0; first < count; first += PACKET_SIZE) {
+			RayPacket<T> packet;
+			for (i = first; i < first + PACKET_SIZE && i < count; i++) {
+				rays[i] = primaryRay(samples[i].x, samples[i].y, supersampling, cameraPosition);
+				packet.setRay(i - first, rays[i]);
+			}
+			scene->closestIntersections(&packet, &intersections[first]);
+		}
+
+		//the things hit so far in each pixel (in the bounds of the samples' pixels), as a chain of shaded colours
+		unsigned int pixelX0 = samples[0].x / supersampling, pixelY0 = samples[0].y / supersampling;
+		unsigned int pixelX1 = pixelX0, pixelY1 = pixelY0;
+		for (i = 1; i < count; i++) {
+			pixelX0 = min(pixelX0, samples[i].x / supersampling);
+			pixelY0 = min(pixelY0, samples[i].y / supersampling);
+			pixelX1 = max(pixelX1, samples[i].x / supersampling);
+			pixelY1 = max(pixelY1, samples[i].y / supersampling);
+		}
+		unsigned int columns = pixelX1 - pixelX0 + 1;
+		vector<int> firstShaded(columns * (pixelY1 - pixelY0 + 1), -1);
+		vector<ShadedHit> shaded;
+
+		//the first sample to hit each thing in a pixel is shaded, and the rest of them get its colour
+		for (i = 0; i < count; i++) {
+			int pixel = (samples[i].y / supersampling - pixelY0) * columns + (samples[i].x / supersampling - pixelX0);
+			int object = intersections[i].objectIndex;
+			int hit = firstShaded[pixel];
+			while (hit >= 0 && shaded[hit].object != object)
+				hit = shaded[hit].next;
+
+			if (hit < 0) {
+				ShadedHit newHit = { object, shadeIntersection(&rays[i], &intersections[i], scene, depth, Vec3<T>(1, 1, 1), shadowCache).template cast<double>(), firstShaded[pixel] };
+				hit = firstShaded[pixel] = shaded.size();
+				shaded.push_back(newHit);
+			}
+
+			colours[samples[i].index] = shaded[hit].colour;
+			objects[samples[i].index] = object;
+		}
+	}
+	else if (traceMode == TRACE_PACKETS) {
+		for (int first = 0; first < count; first += PACKET_SIZE) {
+			RayPacket<T> packet;
+			Ray<T> rays[PACKET_SIZE];
+			Intersection<T> intersections[PACKET_SIZE];
+			int i;
+
+			for (i = 0; i < PACKET_SIZE && first + i < count; i++) {
+				rays[i] = primaryRay(samples[first + i].x, samples[first + i].y, supersampling, cameraPosition);
+				packet.setRay(i, rays[i]);
+			}
+
+			scene->closestIntersections(&packet, intersections);
+
+			for (i = 0; i < PACKET_SIZE && first + i < count; i++) {
+				int index = samples[first + i].index;
+				colours[index] = shadeIntersection(&rays[i], &intersections[i], scene, depth, Vec3<T>(1, 1, 1), shadowCache).template cast<double>();
+				objects[index] = intersections[i].objectIndex;
+			}
+		}
+	}
+	else {
+		for (int i = 0; i < count; i++) {
+			//cast a ray!
+			Ray<T> ray = primaryRay(samples[i].x, samples[i].y, supersampling, cameraPosition);
+			Intersection<T> intersection;
+			scene->closestIntersection(&ray, &intersection);
+
+			colours[samples[i].index] = shadeIntersection(&ray, &intersection, scene, depth, Vec3<T>(1, 1, 1), shadowCache).template cast<double>();
+			objects[samples[i].index] = intersection.objectIndex;
+		}
+	}
+}
+
+//lists a columns x rows grid of samples step apart, starting at x0, y0, in PACKET_WIDTH x PACKET_WIDTH blocks
+//each goes to index row * columns + column
+static void addGrid(unsigned int x0, unsigned int y0, unsigned int columns, unsigned int rows, unsigned int step, vector<Sample>* samples) {
+	for (unsigned int blockX = 0; blockX < columns; blockX += PACKET_WIDTH) {
+		for (unsigned int blockY = 0; blockY < rows; blockY += PACKET_WIDTH) {
+			for (int i = 0; i < PACKET_SIZE; i++) {
+				unsigned int column = blockX + i % PACKET_WIDTH;
+				unsigned int row = blockY + i / PACKET_WIDTH;
+				if (column < columns && row < rows) {
+					Sample sample = { x0 + column * step, y0 + row * step, (int)(row * columns + column) };
+					samples->push_back(sample);
+				}
+			}
+		}
+	}
+}
+
+//whether two samples are different enough that the pixels they're in are worth supersampling
+//(the colours are compared as the image would show them)
+static bool samplesDiffer(const Vector3d& colour1, int object1, const Vector3d& colour2, int object2) {
+	if (object1 != object2)
+		return true;
+
+	Vector3d clamped1 = colour1.cwiseMax(Vector3d(0, 0, 0)).cwiseMin(Vector3d(255, 255, 255));
+	Vector3d clamped2 = colour2.cwiseMax(Vector3d(0, 0, 0)).cwiseMin(Vector3d(255, 255, 255));
+	return (clamped1 - clamped2).cwiseAbs().maxCoeff() > ADAPTIVE_THRESHOLD;
+}
+
+//traces pixels [x0, x1) x [y0, y1) into tileColours (a row at a time), each the average of its supersampling x supersampling samples
+//returns how many samples were traced
+template <typename T>
+static long long renderTile(const Scene<T>* scene, const Vec3<T>& cameraPosition, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1,
+	unsigned int supersampling, int depth, TraceMode traceMode, Wavefront<T>* wavefront, ShadowCache<T>* shadowCache, Vector3d* tileColours) {
+	unsigned int columns = (x1 - x0) * supersampling;
+	unsigned int rows = (y1 - y0) * supersampling;
+	vector<Sample> samples;
+	vector<Vector3d> colours(columns * rows);
+	vector<int> objects(columns * rows);
+
+	addGrid(x0 * supersampling, y0 * supersampling, columns, rows, 1, &samples);
+	traceSamples(scene, cameraPosition, supersampling, depth, traceMode, wavefront, shadowCache, samples, &colours[0], &objects[0]);
+
+	for (unsigned int x = x0; x < x1; x++) {
+		for (unsigned int y = y0; y < y1; y++) {
+			Vector3d colour(0, 0, 0);
+			unsigned int x2, y2;
+			for (x2 = 0; x2 < supersampling; x2++) {
+				for (y2 = 0; y2 < supersampling; y2++) {
+					colour += colours[((y - y0) * supersampling + y2) * columns + (x - x0) * supersampling + x2];
+				}
+			}
+			colour /= (supersampling * supersampling);
+
+			tileColours[(y - y0) * (x1 - x0) + (x - x0)] = colour;
+		}
+	}
+
+	return samples.size();
+}
+
+//finishes pixels [x0, x1) x [y0, y1) into tileColours, given the first sample of each (at x * supersampling, y * supersampling)
+//in baseColours/baseObjects, which cover [baseX0, baseX1) x [baseY0, baseY1) a row at a time
+//with adaptive, only pixels which differ from a neighbour get the rest of their samples, otherwise they all do
+//returns how many samples were traced
+template <typename T>
+static long long refinePixels(const Scene<T>* scene, const Vec3<T>& cameraPosition, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1,
+	unsigned int baseX0, unsigned int baseY0, unsigned int baseX1, unsigned int baseY1, const Vector3d* baseColours, const int* baseObjects,
+	unsigned int supersampling, bool adaptive, int depth, TraceMode traceMode, Wavefront<T>* wavefront, ShadowCache<T>* shadowCache,
+	Vector3d* tileColours) {
+	unsigned int columns = baseX1 - baseX0;
+	int perPixel = supersampling * supersampling;
+	vector<Sample> refinements;
+	vector<unsigned int> refinedX, refinedY;
+
+	//the rest of the samples of every pixel with an edge in it
+	for (unsigned int x = x0; x < x1; x++) {
+		for (unsigned int y = y0; y < y1; y++) {
+			int cell = (y - baseY0) * columns + (x - baseX0);
+			bool edge = !adaptive;
+			for (int neighbour = 0; neighbour < 9 && !edge; neighbour++) {
+				unsigned int neighbourX = x + neighbour % 3 - 1;
+				unsigned int neighbourY = y + neighbour / 3 - 1;
+				if (neighbourX < baseX0 || neighbourX >= baseX1 || neighbourY < baseY0 || neighbourY >= baseY1)
+					continue;
+
+				int neighbourCell = (neighbourY - baseY0) * columns + (neighbourX - baseX0);
+				edge = samplesDiffer(baseColours[cell], baseObjects[cell], baseColours[neighbourCell], baseObjects[neighbourCell]);
+			}
+
+			if (!edge || perPixel == 1) {
+				tileColours[(y - y0) * (x1 - x0) + (x - x0)] = baseColours[cell];
+				continue;
+			}
+
+			int first = refinedX.size() * perPixel;
+			for (int i = 1; i < perPixel; i++) {
+				Sample sample = { x * supersampling + i / supersampling, y * supersampling + i % supersampling, first + i };
+				refinements.push_back(sample);
+			}
+			refinedX.push_back(x);
+			refinedY.push_back(y);
+		}
+	}
+
+	if (refinements.size() == 0)
+		return 0;
+
+	vector<Vector3d> refinedColours(refinedX.size() * perPixel);
+	vector<int> refinedObjects(refinedX.size() * perPixel);
+	traceSamples(scene, cameraPosition, supersampling, depth, traceMode, wavefront, shadowCache, refinements, &refinedColours[0], &refinedObjects[0]);
+
+	//averaged in the same order as renderTile, so these pixels come out the same as they would with every sample
+	for (unsigned int pixel = 0; pixel < refinedX.size(); pixel++) {
+		unsigned int x = refinedX[pixel];
+		unsigned int y = refinedY[pixel];
+		refinedColours[pixel * perPixel] = baseColours[(y - baseY0) * columns + (x - baseX0)];
+
+		Vector3d colour(0, 0, 0);
+		for (int i = 0; i < perPixel; i++)
+			colour += refinedColours[pixel * perPixel + i];
+		colour /= (supersampling * supersampling);
+
+		tileColours[(y - y0) * (x1 - x0) + (x - x0)] = colour;
+	}
+
+	return refinements.size();
+}
+
+//the same as renderTile, but every pixel starts with just its first sample, and only the ones which differ from a neighbour get the rest
+//(most of the image is flat, where the extra samples would all come out the same)
+//the first samples are traced a pixel past each side of the tile, so the pixels on its edges have all their neighbours
+template <typename T>
+static long long renderTileAdaptive(const Scene<T>* scene, const Vec3<T>& cameraPosition, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1,
+	unsigned int imageWidth, unsigned int imageHeight, unsigned int supersampling, int depth, TraceMode traceMode, Wavefront<T>* wavefront,
+	ShadowCache<T>* shadowCache, Vector3d* tileColours) {
+	unsigned int borderX0 = x0 > 0 ? x0 - 1 : 0;
+	unsigned int borderY0 = y0 > 0 ? y0 - 1 : 0;
+	unsigned int borderX1 = min(x1 + 1, imageWidth);
+	unsigned int borderY1 = min(y1 + 1, imageHeight);
+	unsigned int columns = borderX1 - borderX0;
+	unsigned int rows = borderY1 - borderY0;
+	vector<Sample> samples;
+	vector<Vector3d> colours(columns * rows);
+	vector<int> objects(columns * rows);
+
+	addGrid(borderX0 * supersampling, borderY0 * supersampling, columns, rows, supersampling, &samples);
+	traceSamples(scene, cameraPosition, supersampling, depth, traceMode, wavefront, shadowCache, samples, &colours[0], &objects[0]);
+
+	return samples.size() + refinePixels(scene, cameraPosition, x0, y0, x1, y1, borderX0, borderY0, borderX1, borderY1, &colours[0], &objects[0],
+		supersampling, true, depth, traceMode, wavefront, shadowCache, tileColours);
+}
+
+//adds up how the threads' shadow caches did into shadowStats (if it's not NULL)
+template <typename T>
+static void addShadowStats(const vector<ShadowCache<T> >& shadowCaches, ShadowCacheStats* shadowStats) {
+	if (shadowStats == NULL)
+		return;
+
+	shadowStats->tests = 0;
+	shadowStats->hits = 0;
+	for (unsigned int thread = 0; thread < shadowCaches.size(); thread++) {
+		shadowStats->tests += shadowCaches[thread].tests;
+		shadowStats->hits += shadowCaches[thread].hits;
+	}
+}
+
+//the image is split into TILE_SIZE x TILE_SIZE tiles of pixels, traced on threads threads (one per core if it's 0)
+//each is handed to the sink as soon as it's done, so the whole image is never held here at full precision
+//tiles with reflective spheres in them take much longer than the rest, so threads which run out steal from the others
+//every pixel only depends on its own rays (and its neighbours' first samples), so the image is the same whatever the number of threads
+template <typename T>
+long long RayTracer::renderImage(const Scene<T>* scene, const Vec3<T>& cameraPosition, unsigned int imageWidth, unsigned int imageHeight,
+	unsigned int supersampling, bool adaptive, int depth, TraceMode traceMode, int threads, TileSink* sink, RenderLimit* limit,
+	ShadowCacheStats* shadowStats) {
+	int tilesX = (imageWidth + TILE_SIZE - 1) / TILE_SIZE;
+	int tilesY = (imageHeight + TILE_SIZE - 1) / TILE_SIZE;
+
+	if (supersampling < 1)
+		supersampling = 1;
+	if (threads <= 0)
+		threads = threadCount();
+
+	vector<long long> traced(threads, 0);
+	vector<vector<Vector3d> > tileColours(threads, vector<Vector3d>(TILE_SIZE * TILE_SIZE));
+	vector<Wavefront<T> > wavefronts(threads, Wavefront<T>(scene, traceMode == TRACE_BINNED_WAVEFRONT));
+	vector<ShadowCache<T> > shadowCaches(threads, ShadowCache<T>(scene->lights.size()));
+	parallelTasks(tilesX * tilesY, threads, [&](int tile, int thread) {
+		if (limit != NULL && limit->expired())
+			return;
+
+		unsigned int x0 = (tile % tilesX) * TILE_SIZE;
+		unsigned int y0 = (tile / tilesX) * TILE_SIZE;
+		unsigned int x1 = min(x0 + TILE_SIZE, imageWidth);
+		unsigned int y1 = min(y0 + TILE_SIZE, imageHeight);
+		Vector3d* colours = &tileColours[thread][0];
+		if (adaptive)
+			traced[thread] += renderTileAdaptive(scene, cameraPosition, x0, y0, x1, y1, imageWidth, imageHeight, supersampling, depth, traceMode, &wavefronts[thread],
+				&shadowCaches[thread], colours);
+		else
+			traced[thread] += renderTile(scene, cameraPosition, x0, y0, x1, y1, supersampling, depth, traceMode, &wavefronts[thread],
+				&shadowCaches[thread], colours);
+
+		sink->writeTile(x0, y0, x1 - x0, y1 - y0, colours);
+	});
+
+	addShadowStats(shadowCaches, shadowStats);
+
+	long long total = 0;
+	for (int thread = 0; thread < threads; thread++)
+		total += traced[thread];
+	return total;
+}
+
+//lists the pixels in [x0, x1) x [y0, y1) which are first traced in progressive pass pass (as their first samples)
+//pass 0 is every 16th pixel each way, 1 is every 8th (less the ones in pass 0), and so on until pass 4 is the rest
+//they're listed in PACKET_WIDTH x PACKET_WIDTH blocks of the pass's pixels, each going to index y * imageWidth + x
+static void addPassPixels(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, int pass, unsigned int imageWidth,
+	unsigned int supersampling, vector<Sample>* samples) {
+	unsigned int stride = PROGRESSIVE_STRIDE >> pass;
+	unsigned int coarser = stride * 2;
+
+	for (unsigned int blockX = x0; blockX < x1; blockX += PACKET_WIDTH * stride) {
+		for (unsigned int blockY = y0; blockY < y1; blockY += PACKET_WIDTH * stride) {
+			for (int i = 0; i < PACKET_SIZE; i++) {
+				unsigned int x = blockX + (i % PACKET_WIDTH) * stride;
+				unsigned int y = blockY + (i / PACKET_WIDTH) * stride;
+				if (x >= x1 || y >= y1)
+					continue;
+				if (pass > 0 && x % coarser == 0 && y % coarser == 0)
+					continue;
+
+				Sample sample = { x * supersampling, y * supersampling, (int)(y * imageWidth + x) };
+				samples->push_back(sample);
+			}
+		}
+	}
+}
+
+RenderLimit::RenderLimit(double seconds) : cancelFlag(false) {
+	this->seconds = seconds;
+	start = chrono::steady_clock::now();
+}
+
+void RenderLimit::cancel() {
+	cancelFlag.store(true, memory_order_relaxed);
+}
+
+bool RenderLimit::cancelled() const {
+	return cancelFlag.load(memory_order_relaxed);
+}
+
+//whether it's been cancelled or is out of time
+bool RenderLimit::expired() const {
+	return cancelled() || (seconds > 0 && elapsed() >= seconds);
+}
+
+double RenderLimit::elapsed() const {
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+//fills in colours for [x0, x1) x [y0, y1) as it is once progressive pass pass is done everywhere
+//each pixel shows the corner of the block of pixels it's in, which is in the same tile (they're a multiple of the blocks)
+static void fillPass(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, int pass, unsigned int imageWidth,
+	const Vector3d* baseColours, Vector3d* colours) {
+	unsigned int stride = PROGRESSIVE_STRIDE >> pass;
+	for (unsigned int y = y0; y < y1; y++) {
+		for (unsigned int x = x0; x < x1; x++)
+			colours[(y - y0) * (x1 - x0) + (x - x0)] = baseColours[(y - y % stride) * imageWidth + (x - x % stride)];
+	}
+}
+
+//the same image as renderImage, but traced coarse to fine so the whole of it is there early on
+//the first samples of every 16th pixel each way go first (1/256 of them), then every 8th, 4th and 2nd, then the rest, then the supersampling
+//after each pass every tile is handed to the sink again, with the pixels not traced yet filled in from the nearest one which has been
+//the first samples are reused by the later passes, so nothing is traced twice, but it keeps one colour per pixel to do it
+//(unlike renderImage, which only ever holds tiles)
+//with a limit, tiles stop being started once it runs out, and the tiles which did get through the unfinished pass are handed to
+//the sink again as they were after the one before, so the image is all one quality
+//the first pass is always finished, limit or not: it's cheap enough not to matter, and it means there's always a whole image
+template <typename T>
+long long RayTracer::renderProgressive(const Scene<T>* scene, const Vec3<T>& cameraPosition, unsigned int imageWidth, unsigned int imageHeight,
+	unsigned int supersampling, bool adaptive, int depth, TraceMode traceMode, int threads, TileSink* sink, RenderLimit* limit, RenderQuality* quality,
+	ProgressiveTimes* times, ShadowCacheStats* shadowStats) {
+	int tilesX = (imageWidth + TILE_SIZE - 1) / TILE_SIZE;
+	int tilesY = (imageHeight + TILE_SIZE - 1) / TILE_SIZE;
+	int tiles = tilesX * tilesY;
+
+	if (supersampling < 1)
+		supersampling = 1;
+	if (threads <= 0)
+		threads = threadCount();
+
+	vector<Vector3d> baseColours(imageWidth * imageHeight);
+	vector<int> baseObjects(imageWidth * imageHeight);
+	vector<long long> traced(threads, 0);
+	vector<vector<Vector3d> > tileColours(threads, vector<Vector3d>(TILE_SIZE * TILE_SIZE));
+	vector<Wavefront<T> > wavefronts(threads, Wavefront<T>(scene, traceMode == TRACE_BINNED_WAVEFRONT));
+	vector<ShadowCache<T> > shadowCaches(threads, ShadowCache<T>(scene->lights.size()));
+	vector<char> tileDone(tiles);
+	int passes = supersampling > 1 ? PROGRESSIVE_PASSES + 1 : PROGRESSIVE_PASSES;
+	int finished = 0;
+	double passSeconds[QUALITY_SUPERSAMPLED];
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	for (int pass = 0; pass < passes; pass++) {
+		bool abortLoop = false;
+		fill(tileDone.begin(), tileDone.end(), 0);
+
+		parallelTasks(tiles, threads, [&](int tile, int thread) {
+			if (pass > 0 && limit != NULL && limit->expired())
+				return;
+
+			unsigned int x0 = (tile % tilesX) * TILE_SIZE;
+			unsigned int y0 = (tile / tilesX) * TILE_SIZE;
+			unsigned int x1 = min(x0 + TILE_SIZE, imageWidth);
+			unsigned int y1 = min(y0 + TILE_SIZE, imageHeight);
+			Vector3d* colours = &tileColours[thread][0];
+
+			if (pass < PROGRESSIVE_PASSES) {
+				vector<Sample> samples;
+				addPassPixels(x0, y0, x1, y1, pass, imageWidth, supersampling, &samples);
+				traceSamples(scene, cameraPosition, supersampling, depth, traceMode, &wavefronts[thread], &shadowCaches[thread], samples, &baseColours[0], &baseObjects[0]);
+				traced[thread] += samples.size();
+				fillPass(x0, y0, x1, y1, pass, imageWidth, &baseColours[0], colours);
+			}
+			else {
+				traced[thread] += refinePixels(scene, cameraPosition, x0, y0, x1, y1, 0, 0, imageWidth, imageHeight, &baseColours[0], &baseObjects[0],
+					supersampling, adaptive, depth, traceMode, &wavefronts[thread], &shadowCaches[thread], colours);
+			}
+
+			sink->writeTile(x0, y0, x1 - x0, y1 - y0, colours);
+			tileDone[tile] = 1;
+		});
+
+		for (int tile = 0; tile < tiles; tile++) {
+			if (!tileDone[tile])
+				abortLoop = true;
+		}
+		if (abortLoop) {
+			//put back the tiles which got ahead (the first samples of every pixel are kept for the last pass, so it never needs them back)
+			//(the first pass always finishes, so there's always one before)
+			parallelTasks(tiles, threads, [&](int tile, int thread) {
+				if (!tileDone[tile])
+					return;
+
+				unsigned int x0 = (tile % tilesX) * TILE_SIZE;
+				unsigned int y0 = (tile / tilesX) * TILE_SIZE;
+				unsigned int x1 = min(x0 + TILE_SIZE, imageWidth);
+				unsigned int y1 = min(y0 + TILE_SIZE, imageHeight);
+				Vector3d* colours = &tileColours[thread][0];
+				fillPass(x0, y0, x1, y1, pass - 1, imageWidth, &baseColours[0], colours);
+				sink->writeTile(x0, y0, x1 - x0, y1 - y0, colours);
+			});
+			break;
+		}
+
+		passSeconds[pass] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		finished = pass + 1;
+	}
+
+	if (quality != NULL)
+		*quality = (RenderQuality)finished;
+	if (times != NULL) {
+		times->passes = passes;
+		copy(passSeconds, passSeconds + finished, times->passSeconds);
+		times->totalSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}
+	addShadowStats(shadowCaches, shadowStats);
+
+	long long total = 0;
+	for (int thread = 0; thread < threads; thread++)
+		total += traced[thread];
+	return total;
+}
+
+template Vec3<float> RayTracer::traceRay(Ray<float>*, const Scene<float>*, int, const Vec3<float>&, ShadowCache<float>*);
+template Vec3<double> RayTracer::traceRay(Ray<double>*, const Scene<double>*, int, const Vec3<double>&, ShadowCache<double>*);
+template Vec3<float> RayTracer::shadeIntersection(Ray<float>*, Intersection<float>*, const Scene<float>*, int, const Vec3<float>&, ShadowCache<float>*);
+template Vec3<double> RayTracer::shadeIntersection(Ray<double>*, Intersection<double>*, const Scene<double>*, int, const Vec3<double>&, ShadowCache<double>*);
+template bool RayTracer::continuePath(const Ray<float>&, float, float*);
+template bool RayTracer::continuePath(const Ray<double>&, double, double*);
+template Ray<float> RayTracer::primaryRay(unsigned int, unsigned int, unsigned int, const Vec3<float>&);
+template Ray<double> RayTracer::primaryRay(unsigned int, unsigned int, unsigned int, const Vec3<double>&);
+template long long RayTracer::renderImage(const Scene<float>*, const Vec3<float>&, unsigned int, unsigned int, unsigned int, bool, int, TraceMode, int, TileSink*, RenderLimit*, ShadowCacheStats*);
+template long long RayTracer::renderImage(const Scene<double>*, const Vec3<double>&, unsigned int, unsigned int, unsigned int, bool, int, TraceMode, int, TileSink*, RenderLimit*, ShadowCacheStats*);
+template long long RayTracer::renderProgressive(const Scene<float>*, const Vec3<float>&, unsigned int, unsigned int, unsigned int, bool, int, TraceMode, int, TileSink*, RenderLimit*, RenderQuality*, ProgressiveTimes*, ShadowCacheStats*);
+template long long RayTracer::renderProgressive(const Scene<double>*, const Vec3<double>&, unsigned int, unsigned int, unsigned int, bool, int, TraceMode, int, TileSink*, RenderLimit*, RenderQuality*, ProgressiveTimes*, ShadowCacheStats*);
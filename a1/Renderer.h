@@ -0,0 +1,109 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <Eigen\Dense>
+#include <atomic>
+#include <chrono>
+#include "Ray.h"
+#include "Scene.h"
+
+using namespace Eigen;
+
+namespace RayTracer {
+	//the tracing functions, in whatever precision the scene was compiled in
+	//(instantiated for float and double)
+	//throughput is how much of the colour found gets to the sample, for each colour (less for each reflection on the way)
+	//shadowCache is the calling thread's, for the shadow rays (NULL to search for every one from scratch)
+	template <typename T>
+	Vec3<T> traceRay(Ray<T>* ray, const Scene<T>* scene, int remainingDepth, const Vec3<T>& throughput = Vec3<T>::Ones(),
+		ShadowCache<T>* shadowCache = NULL);
+	template <typename T>
+	Vec3<T> shadeIntersection(Ray<T>* ray, Intersection<T>* intersection, const Scene<T>* scene, int remainingDepth,
+		const Vec3<T>& throughput = Vec3<T>::Ones(), ShadowCache<T>* shadowCache = NULL);
+	//russian roulette, for a reflection which would get throughput (its largest colour) of its colour to the sample
+	//once that's under the threshold, only some are traced, and weight (to multiply the colour they find by) makes up for the rest
+	//the choice is made from the ray itself, so the same ray always gets the same one, on any thread
+	template <typename T>
+	bool continuePath(const Ray<T>& ray, T throughput, T* weight);
+	template <typename T>
+	Ray<T> primaryRay(unsigned int x, unsigned int y, unsigned int supersampling, const Vec3<T>& cameraPosition);
+
+	//receives the image a tile at a time, as each is traced
+	//colours holds width x height pixel colours a row at a time (y up, like the samples), with the tile's corner at x0, y0
+	//it's called from whichever thread traced the tile, so it has to be safe to call from several at once
+	//(it only has to keep the colours if it wants them, they're overwritten by the next tile)
+	class TileSink {
+	public:
+		virtual ~TileSink() {}
+		virtual void writeTile(unsigned int x0, unsigned int y0, unsigned int width, unsigned int height, const Vector3d* colours) = 0;
+	};
+
+	//how samples are traced: a ray at a time (recursing into reflections), with the primaries in packets,
+	//or a stage at a time over the whole batch (see Wavefront), which keeps deep reflections from stalling the rest
+	//TRACE_BINNED_WAVEFRONT also sorts each bounce's reflections by direction and origin before tracing them
+	//TRACE_DECOUPLED finds every sample's hit (in packets) but shades once for each thing hit in a pixel, like MSAA,
+	//so supersampling only costs the extra primary rays (edges are still smooth, but reflections and shadows aren't)
+	enum TraceMode { TRACE_RAYS, TRACE_PACKETS, TRACE_WAVEFRONT, TRACE_BINNED_WAVEFRONT, TRACE_DECOUPLED };
+
+	//how the threads' shadow caches did over a render: shadow rays which had an occluder cached to try, and how many it blocked
+	//(each of those skipped the search)
+	struct ShadowCacheStats {
+		long long tests;
+		long long hits;
+	};
+
+	//stops a render early, once seconds seconds have passed since it was made (0 for no limit) or once cancel is called
+	//cancel can be called from any thread, while the render is going
+	class RenderLimit {
+	public:
+		RenderLimit(double seconds = 0);
+		void cancel();
+		bool cancelled() const;
+		bool expired() const;
+		double elapsed() const;
+
+		double seconds;
+		std::chrono::steady_clock::time_point start;
+
+	private:
+		std::atomic<bool> cancelFlag;
+	};
+
+	//traces the image into sink, each pixel the average of supersampling x supersampling samples
+	//with adaptive, pixels get one sample, and only those which differ from a neighbour (in colour or in what was hit) get the rest
+	//traced on threads threads (0 for one per core) the way traceMode says, returns how many samples were traced
+	//colours are passed on as double whatever T is, so images traced in either precision can be compared
+	//with a limit, tiles stop being started once it runs out, and the ones which weren't are never given to sink
+	//(limit->expired() says whether the image might be missing tiles)
+	//each thread keeps a ShadowCache, and how they did is put in shadowStats (if it's not NULL)
+	template <typename T>
+	long long renderImage(const Scene<T>* scene, const Vec3<T>& cameraPosition, unsigned int imageWidth, unsigned int imageHeight,
+		unsigned int supersampling, bool adaptive, int depth, TraceMode traceMode, int threads, TileSink* sink,
+		RenderLimit* limit = NULL, ShadowCacheStats* shadowStats = NULL);
+
+	//how far a progressive render got, each a whole image
+	//with no supersampling, QUALITY_FULL is the finished image
+	enum RenderQuality { QUALITY_NONE, QUALITY_TWO_FIFTY_SIXTH, QUALITY_SIXTY_FOURTH, QUALITY_SIXTEENTH, QUALITY_QUARTER, QUALITY_FULL,
+		QUALITY_SUPERSAMPLED };
+
+	//when a progressive render's passes ended, in seconds from its start
+	//passSeconds[p] for each pass p it finished (as many as the quality it got to), and totalSeconds for the whole render,
+	//which includes the pass it stopped partway through if it ran out of time
+	struct ProgressiveTimes {
+		int passes; //how many it would have taken to finish
+		double passSeconds[QUALITY_SUPERSAMPLED];
+		double totalSeconds;
+	};
+
+	//the same, but traced coarse to fine (1/256 of the pixels, 1/64, 1/16, 1/4, all of them, then the supersampling)
+	//with the whole image given to sink after each pass, so there's something to look at early on
+	//if limit runs out, it stops with sink holding the last pass which was finished everywhere (put in quality, if it's not NULL)
+	//the first pass is always finished, even past the limit, so that's at least QUALITY_TWO_FIFTY_SIXTH
+	//how long the passes took is put in times (if it's not NULL)
+	template <typename T>
+	long long renderProgressive(const Scene<T>* scene, const Vec3<T>& cameraPosition, unsigned int imageWidth, unsigned int imageHeight,
+		unsigned int supersampling, bool adaptive, int depth, TraceMode traceMode, int threads, TileSink* sink,
+		RenderLimit* limit = NULL, RenderQuality* quality = NULL, ProgressiveTimes* times = NULL, ShadowCacheStats* shadowStats = NULL);
+}
+
+#endif
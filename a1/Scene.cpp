@@ -0,0 +1,657 @@
+#include "Scene.h"
+#include <limits>
+#include "Hash.h"
+
+using namespace RayTracer;
+using namespace Eigen;
+using namespace std;
+
+template <typename T>
+Material<T>::Material(const Vec3<T>& colour, T reflectivity) {
+	this->colour = colour;
+	this->reflectivity = reflectivity;
+}
+
+template <typename T>
+Light<T>::Light(const Vec3<T>& position, const Vec3<T>& colour, T radius) {
+	this->position = position;
+	this->colour = colour;
+	this->radius = radius;
+}
+
+//how much of the light reaches distanceSquared away: (1 - d^2/r^2)^2, which is 1 at the light and goes smoothly to 0 at radius
+template <typename T>
+T Light<T>::falloff(T distanceSquared) const {
+	if (radius <= 0)
+		return 1;
+
+	T fade = 1 - distanceSquared / (radius * radius);
+	return fade > 0 ? fade * fade : 0;
+}
+
+template <typename T>
+ShadowCache<T>::ShadowCache(int lights) {
+	Occluder none = { OCCLUDER_NONE, -1 };
+	occluders.assign(lights, none);
+	tests = 0;
+	hits = 0;
+}
+
+/*=======
+ * BUILD
+ *=======*/
+template <typename T>
+Scene<T>::Scene(vector<SceneObject*>* objects, vector<SceneObject*>* lights, SphereAccelerator sphereAccelerator) {
+	unsigned int i;
+	vector<Sphere*> sphereObjects;
+	vector<int> sphereIndices;
+	vector<Box3<T> > sphereBounds;
+
+	//instances are added once they're all known, in the order of the BVH over them
+	map<Mesh*, int> meshIndices;
+	unordered_multimap<unsigned long long, int> materialIndices;
+	vector<int> instanceMeshes;
+	AlignedArray<Transform<T, 3, Affine> > instanceTransforms;
+	vector<int> instanceMaterials;
+	vector<int> instanceIndices;
+	vector<Box3<T> > instanceBounds;
+
+	for (i = 0; i < objects->size(); i++) {
+		SceneObject* obj = (*objects)[i];
+		Sphere* sphere = dynamic_cast<Sphere*>(obj);
+		Plane* plane = dynamic_cast<Plane*>(obj);
+		Mesh* mesh = dynamic_cast<Mesh*>(obj);
+		Instance* instance = dynamic_cast<Instance*>(obj);
+		Transform<T, 3, Affine> transform = Transform<T, 3, Affine>::Identity();
+
+		//a mesh on its own is just an instance of it which doesn't move it
+		if (instance != NULL && dynamic_cast<Mesh*>(instance->geometry) != NULL) {
+			mesh = dynamic_cast<Mesh*>(instance->geometry);
+			transform = instance->transform.cast<T>();
+		}
+
+		if (sphere != NULL) {
+			AlignedBox3d bounds;
+			sphere->getBounds(&bounds);
+			sphereObjects.push_back(sphere);
+			sphereIndices.push_back(i);
+			sphereBounds.push_back(bounds.cast<T>());
+		}
+		else if (plane != NULL) {
+			planes.add(plane->position->cast<T>(), plane->normal->cast<T>(), addMaterial(plane, &materialIndices), i);
+		}
+		else if (mesh != NULL && mesh->triangleCount() > 0) {
+			int meshIndex = addMesh(mesh, &meshIndices);
+			instanceMeshes.push_back(meshIndex);
+			instanceTransforms.push_back(transform);
+			instanceMaterials.push_back(addMaterial(obj, &materialIndices));
+			instanceIndices.push_back(i);
+			instanceBounds.push_back(instances.worldBounds(meshIndex, transform));
+		}
+		else {
+			printf("Scene: skipping object %d, it isn't a type the scene knows about (", i);
+			obj->printName();
+			printf(")\n");
+		}
+	}
+
+	bvh = NULL;
+	grid = NULL;
+	this->sphereAccelerator = sphereAccelerator;
+	vector<int> sphereOrder;
+	buildSphereAccelerator(sphereBounds, &sphereOrder);
+
+	for (i = 0; i < sphereOrder.size(); i++) {
+		Sphere* sphere = sphereObjects[sphereOrder[i]];
+		spheres.add(sphere->position->cast<T>(), (T)sphere->radius, addMaterial(sphere, &materialIndices), sphereIndices[sphereOrder[i]]);
+	}
+
+	instanceBVH = new BVH<T>(instanceBounds);
+	for (i = 0; i < instanceBVH->primIndices.size(); i++) {
+		int instance = instanceBVH->primIndices[i];
+		instances.add(instanceMeshes[instance], instanceTransforms[instance], instanceMaterials[instance], instanceIndices[instance]);
+	}
+
+	for (i = 0; i < lights->size(); i++) {
+		SceneObject* light = (*lights)[i];
+		this->lights.push_back(Light<T>(light->position->cast<T>(), light->colour->cast<T>(), (T)light->lightRadius));
+	}
+
+	lightBVH = NULL;
+	lightSamples = 0;
+	buildLightBVH();
+	lightGrid = NULL;
+	cullLights = true;
+	buildLightGrid();
+	cacheOccluders = true;
+}
+
+template <typename T>
+Scene<T>::~Scene() {
+	delete bvh;
+	delete grid;
+	delete instanceBVH;
+	delete lightBVH;
+	delete lightGrid;
+}
+
+//builds whichever of the BVH and grid the scene uses over the spheres
+//fills in the order the spheres have to be stored in: with a BVH, the order its leaves reference them
+//(the grid's cells refer to them by index, so they're left in order)
+//a BVH which already exists is rebuilt in place, so its arrays aren't reallocated every frame
+template <typename T>
+void Scene<T>::buildSphereAccelerator(const vector<Box3<T> >& sphereBounds, vector<int>* sphereOrder) {
+	sphereOrder->clear();
+
+	if (sphereAccelerator == SPHERE_GRID) {
+		delete grid;
+		grid = new Grid<T>(sphereBounds);
+		for (unsigned int i = 0; i < sphereBounds.size(); i++)
+			sphereOrder->push_back(i);
+	}
+	else {
+		BVHBuild build = sphereAccelerator == SPHERE_LBVH ? BVH_BUILD_MORTON : BVH_BUILD_SAH;
+		if (bvh == NULL)
+			bvh = new BVH<T>(sphereBounds, build);
+		else
+			bvh->rebuild(sphereBounds, build);
+		*sphereOrder = bvh->primIndices;
+	}
+}
+
+//for scenes whose spheres move between frames: re-reads every sphere's centre and radius from the objects
+//the scene was built from (the same list, in the same order) and rebuilds what finds them
+//spheres can't be added or removed, and their materials are kept
+template <typename T>
+void Scene<T>::updateSpheres(vector<SceneObject*>* objects) {
+	int i;
+	int count = spheres.size();
+	vector<Box3<T> > sphereBounds(count);
+
+	for (i = 0; i < count; i++) {
+		Sphere* sphere = (Sphere*)(*objects)[spheres.object[i]];
+		Vec3<T> centre = sphere->position->cast<T>();
+		Vec3<T> extent = Vec3<T>::Constant((T)sphere->radius);
+		sphereBounds[i] = Box3<T>(centre - extent, centre + extent);
+	}
+
+	vector<int> sphereOrder;
+	buildSphereAccelerator(sphereBounds, &sphereOrder);
+
+	//written over the old arrays in the new order, only the indices have to be copied first
+	AlignedArray<int> materials = spheres.material;
+	AlignedArray<int> objectIndices = spheres.object;
+	for (i = 0; i < count; i++) {
+		int old = sphereOrder[i];
+		Sphere* sphere = (Sphere*)(*objects)[objectIndices[old]];
+		spheres.x[i] = (T)(*sphere->position)(0);
+		spheres.y[i] = (T)(*sphere->position)(1);
+		spheres.z[i] = (T)(*sphere->position)(2);
+		spheres.radius[i] = (T)sphere->radius;
+		spheres.radiusSquared[i] = spheres.radius[i] * spheres.radius[i];
+		spheres.material[i] = materials[old];
+		spheres.object[i] = objectIndices[old];
+	}
+}
+
+//returns the index of the object's material, sharing one with an earlier object if they're the same
+//materialIndices finds the earlier ones from a hash of the colour and reflectivity, so scenes of many differently coloured
+//objects don't compare each against every material so far
+template <typename T>
+int Scene<T>::addMaterial(SceneObject* object, unordered_multimap<unsigned long long, int>* materialIndices) {
+	Vec3<T> colour = object->colour->cast<T>();
+	T reflectivity = (T)object->reflectivity;
+
+	//(adding 0 turns -0 into 0, which compares equal to it)
+	unsigned long long hash = mixHash(0, scalarBits(reflectivity + 0));
+	for (int channel = 0; channel < 3; channel++)
+		hash = mixHash(hash, scalarBits(colour(channel) + 0));
+
+	typedef unordered_multimap<unsigned long long, int>::iterator Iterator;
+	pair<Iterator, Iterator> found = materialIndices->equal_range(hash);
+	for (Iterator i = found.first; i != found.second; i++) {
+		const Material<T>& material = materials[i->second];
+		if (material.colour == colour && material.reflectivity == reflectivity)
+			return i->second;
+	}
+
+	materials.push_back(Material<T>(colour, reflectivity));
+	materialIndices->insert(make_pair(hash, (int)materials.size() - 1));
+	return materials.size() - 1;
+}
+
+//returns the index of the mesh's geometry in instances, compiling it the first time it's seen
+//it gets its own BVH, with its triangles stored in that BVH's leaf order
+template <typename T>
+int Scene<T>::addMesh(Mesh* mesh, map<Mesh*, int>* meshIndices) {
+	typename map<Mesh*, int>::iterator found = meshIndices->find(mesh);
+	if (found != meshIndices->end())
+		return found->second;
+
+	int i;
+	int triangleCount = mesh->triangleCount();
+
+	vector<Vec3<T> > vertices(mesh->vertices.size());
+	for (i = 0; i < (int)vertices.size(); i++)
+		vertices[i] = mesh->vertices[i].cast<T>();
+
+	vector<Box3<T> > triangleBounds(triangleCount);
+	for (i = 0; i < triangleCount; i++) {
+		triangleBounds[i].extend(vertices[mesh->triangles[i * 3]]);
+		triangleBounds[i].extend(vertices[mesh->triangles[i * 3 + 1]]);
+		triangleBounds[i].extend(vertices[mesh->triangles[i * 3 + 2]]);
+	}
+
+	BVH<T>* meshBVH = new BVH<T>(triangleBounds);
+	TriangleArray<T>* triangles = new TriangleArray<T>();
+	for (i = 0; i < triangleCount; i++) {
+		int triangle = meshBVH->primIndices[i];
+		triangles->add(vertices[mesh->triangles[triangle * 3]], vertices[mesh->triangles[triangle * 3 + 1]], vertices[mesh->triangles[triangle * 3 + 2]]);
+	}
+
+	int meshIndex = instances.addMesh(triangles, meshBVH);
+	(*meshIndices)[mesh] = meshIndex;
+	return meshIndex;
+}
+
+/*==============
+ * INTERSECTION
+ *==============*/
+template <typename T>
+void Scene<T>::fillSphereIntersection(int sphere, const Vec3<T>& origin, const Vec3<T>& direction, T t, Intersection<T>* intersection) const {
+	Vec3<T> centre(spheres.x[sphere], spheres.y[sphere], spheres.z[sphere]);
+	intersection->point = origin + direction * t;
+	intersection->normal = (intersection->point - centre) / spheres.radius[sphere];
+	intersection->t = t;
+	intersection->objectIndex = spheres.object[sphere];
+	intersection->material = spheres.material[sphere];
+}
+
+//triangles are two sided, so the normal is flipped to face back along the ray
+template <typename T>
+void Scene<T>::fillTriangleIntersection(int instance, int triangle, const Vec3<T>& origin, const Vec3<T>& direction, T t, Intersection<T>* intersection) const {
+	intersection->point = origin + direction * t;
+	intersection->normal = instances.normal(instance, triangle);
+	if (intersection->normal.dot(direction) > 0)
+		intersection->normal = -intersection->normal;
+	intersection->t = t;
+	intersection->objectIndex = instances.object[instance];
+	intersection->material = instances.material[instance];
+}
+
+//returns the index of the nearest sphere within the ray's range and shrinks ray->tMax to it, or -1
+template <typename T>
+int Scene<T>::closestSphere(Ray<T>* ray) const {
+	if (grid != NULL)
+		return grid->closestIntersection(spheres, ray);
+	return bvh->closestIntersection(spheres, ray);
+}
+
+template <typename T>
+bool Scene<T>::closestPlaneIntersection(Ray<T>* ray, Intersection<T>* intersection) const {
+	T t;
+	int plane = planes.intersect(*ray, &t);
+	if (plane < 0)
+		return false;
+
+	ray->tMax = t;
+	intersection->point = ray->origin + ray->direction * t;
+	intersection->normal = Vec3<T>(planes.normalX[plane], planes.normalY[plane], planes.normalZ[plane]);
+	intersection->t = t;
+	intersection->objectIndex = planes.object[plane];
+	intersection->material = planes.material[plane];
+	return true;
+}
+
+//fills in the nearest intersection within [ray->tMin, ray->tMax] and returns true
+//ray->tMax is left at the distance to that intersection
+template <typename T>
+bool Scene<T>::closestIntersection(Ray<T>* ray, Intersection<T>* intersection) const {
+	//planes first so the BVH has a shorter ray to cull against
+	bool hit = closestPlaneIntersection(ray, intersection);
+
+	//everything after is only hit inside what's left of the ray, so anything found is closer
+	int triangle;
+	int instance = instanceBVH->closestIntersection(instances, ray, &triangle);
+	if (instance >= 0) {
+		fillTriangleIntersection(instance, triangle, ray->origin, ray->direction, ray->tMax, intersection);
+		hit = true;
+	}
+
+	int sphere = closestSphere(ray);
+	if (sphere >= 0) {
+		fillSphereIntersection(sphere, ray->origin, ray->direction, ray->tMax, intersection);
+		hit = true;
+	}
+
+	return hit;
+}
+
+//whether anything is hit between Ray<T>::epsilon and tMax along the ray, for shadow rays
+//the epsilon keeps the ray from hitting the surface it starts on, without having to skip that object entirely
+//if it's a sphere or an instance, which one is put in occluder (if it's not NULL, otherwise it's left as it was)
+template <typename T>
+bool Scene<T>::occluded(const Vec3<T>& origin, const Vec3<T>& direction, T tMax, Occluder* occluder) const {
+	Ray<T> ray(origin, direction, Ray<T>::epsilon, tMax);
+	if (planes.intersectsAny(ray))
+		return true;
+
+	int index;
+	OccluderType type;
+	if (grid != NULL ? grid->occluded(spheres, ray, &index) : bvh->occluded(spheres, ray, &index))
+		type = OCCLUDER_SPHERE;
+	else if (instanceBVH->occluded(instances, ray, &index))
+		type = OCCLUDER_INSTANCE;
+	else
+		return false;
+
+	if (occluder != NULL) {
+		occluder->type = type;
+		occluder->index = index;
+	}
+	return true;
+}
+
+//the same, for a shadow ray to light, but the last thing which blocked that light in cache is tried first
+//only if it doesn't block this one is everything else searched (and what does, if anything, is cached instead)
+template <typename T>
+bool Scene<T>::occluded(const Vec3<T>& origin, const Vec3<T>& direction, T tMax, int light, ShadowCache<T>* cache) const {
+	if (cache == NULL || !cacheOccluders)
+		return occluded(origin, direction, tMax);
+
+	Occluder& cached = cache->occluders[light];
+	if (cached.type != OCCLUDER_NONE) {
+		Ray<T> ray(origin, direction, Ray<T>::epsilon, tMax);
+		bool blocked = cached.type == OCCLUDER_SPHERE ? spheres.intersectsAny(ray, cached.index, 1) : instances.intersectsAny(ray, cached.index, 1);
+
+		cache->tests++;
+		if (blocked) {
+			cache->hits++;
+			return true;
+		}
+	}
+
+	//if nothing blocks it, the next ray is likely to get through too, so there's nothing worth trying first
+	//(a plane leaves the cache as it was)
+	if (occluded(origin, direction, tMax, &cached))
+		return true;
+	cached.type = OCCLUDER_NONE;
+	return false;
+}
+
+//finds the nearest intersection for every ray in the packet at once
+//intersections for rays which hit nothing are left with an objectIndex of -1
+template <typename T>
+void Scene<T>::closestIntersections(RayPacket<T>* packet, Intersection<T>* intersections) const {
+	int i;
+	int hitSpheres[PACKET_SIZE];
+
+	for (i = 0; i < PACKET_SIZE; i++) {
+		hitSpheres[i] = -1;
+		if (!packet->isActive(i))
+			continue;
+
+		//there are only ever a few planes, so they're just tested a ray at a time
+		Ray<T> ray = packet->getRay(i);
+		closestPlaneIntersection(&ray, &intersections[i]);
+		packet->tMax[i] = ray.tMax;
+	}
+
+	//each stage only finds hits closer than the ones before, so they can just overwrite
+	int hitInstances[PACKET_SIZE];
+	int hitTriangles[PACKET_SIZE];
+	for (i = 0; i < PACKET_SIZE; i++)
+		hitInstances[i] = -1;
+
+	instanceBVH->closestIntersections(instances, packet, hitInstances, hitTriangles);
+
+	for (i = 0; i < PACKET_SIZE; i++) {
+		if (hitInstances[i] >= 0) {
+			fillTriangleIntersection(hitInstances[i], hitTriangles[i],
+				Vec3<T>(packet->originX[i], packet->originY[i], packet->originZ[i]),
+				Vec3<T>(packet->directionX[i], packet->directionY[i], packet->directionZ[i]),
+				packet->tMax[i], &intersections[i]);
+		}
+	}
+
+	if (grid != NULL) {
+		//the grid is walked a ray at a time
+		for (i = 0; i < PACKET_SIZE; i++) {
+			if (!packet->isActive(i))
+				continue;
+
+			Ray<T> ray = packet->getRay(i);
+			int sphere = grid->closestIntersection(spheres, &ray);
+			if (sphere >= 0) {
+				packet->tMax[i] = ray.tMax;
+				hitSpheres[i] = sphere;
+			}
+		}
+	}
+	else {
+		bvh->closestIntersections(spheres, packet, hitSpheres);
+	}
+
+	for (i = 0; i < PACKET_SIZE; i++) {
+		if (hitSpheres[i] >= 0) {
+			fillSphereIntersection(hitSpheres[i],
+				Vec3<T>(packet->originX[i], packet->originY[i], packet->originZ[i]),
+				Vec3<T>(packet->directionX[i], packet->directionY[i], packet->directionZ[i]),
+				packet->tMax[i], &intersections[i]);
+		}
+	}
+}
+
+/*========
+ * LIGHTS
+ *========*/
+//the lights as points, built from Morton codes (which doesn't mind boxes with no size, unlike the SAH)
+//then each node's power, children before parents
+template <typename T>
+void Scene<T>::buildLightBVH() {
+	vector<Box3<T> > lightBounds;
+	for (unsigned int i = 0; i < lights.size(); i++)
+		lightBounds.push_back(Box3<T>(lights[i].position, lights[i].position));
+
+	lightBVH = new BVH<T>(lightBounds, BVH_BUILD_MORTON);
+	lightNodePower.assign(lightBVH->nodes.size(), 0);
+	lightNodeRadius.assign(lightBVH->nodes.size(), 0);
+	if (lightBVH->nodes.empty())
+		return;
+
+	//every node reached from the root, parents first
+	vector<int> order;
+	vector<int> stack(1, 0);
+	while (!stack.empty()) {
+		int node = stack.back();
+		stack.pop_back();
+		order.push_back(node);
+		if (lightBVH->nodes[node].count == 0) {
+			stack.push_back(lightBVH->nodes[node].left);
+			stack.push_back(lightBVH->nodes[node].right);
+		}
+	}
+
+	for (int i = (int)order.size() - 1; i >= 0; i--) {
+		const BVHNode<T>& node = lightBVH->nodes[order[i]];
+		T power = 0;
+		T radius = 0;
+		if (node.count > 0) {
+			for (int light = node.start; light < node.start + node.count; light++) {
+				const Light<T>& leafLight = lights[lightBVH->primIndices[light]];
+				power += leafLight.colour.sum();
+				radius = max(radius, leafLight.radius > 0 ? leafLight.radius : numeric_limits<T>::infinity());
+			}
+		}
+		else {
+			power = lightNodePower[node.left] + lightNodePower[node.right];
+			radius = max(lightNodeRadius[node.left], lightNodeRadius[node.right]);
+		}
+		lightNodePower[order[i]] = power;
+		lightNodeRadius[order[i]] = radius;
+	}
+}
+
+//roughly how much the lights under node could light point: their power over the square of how far away they are
+//(from the middle of their bounds, but at least half the bounds' diagonal, so nodes around the point don't get too little)
+//it only decides how likely they are to be picked, so it only has to be more than 0 for any light which could light it
+//(so it's 0 when the point is out of reach of all of them)
+template <typename T>
+T Scene<T>::lightImportance(int node, const Vec3<T>& point) const {
+	const Box3<T>& bounds = lightBVH->nodes[node].bounds;
+	T radius = lightNodeRadius[node];
+	if (bounds.squaredExteriorDistance(point) >= radius * radius)
+		return 0;
+
+	T distanceSquared = (bounds.center() - point).squaredNorm();
+	distanceSquared = max(distanceSquared, bounds.diagonal().squaredNorm() / 4);
+	return lightNodePower[node] / max(distanceSquared, (T)1);
+}
+
+//picks a light to light point with, each with the probability it's given (put in probability)
+//u (in [0, 1)) picks it, going down lightBVH towards the more important child, then within the leaf the same way
+//returns -1 if no light has any power, or none reaches the point
+template <typename T>
+int Scene<T>::sampleLight(const Vec3<T>& point, double u, T* probability) const {
+	*probability = 1;
+	if (lightBVH->nodes.empty() || lightImportance(0, point) <= 0)
+		return -1;
+
+	int node = 0;
+	while (lightBVH->nodes[node].count == 0) {
+		const BVHNode<T>& interior = lightBVH->nodes[node];
+		T leftImportance = lightImportance(interior.left, point);
+		T rightImportance = lightImportance(interior.right, point);
+		if (leftImportance + rightImportance <= 0)
+			return -1;
+		double leftProbability = leftImportance / (double)(leftImportance + rightImportance);
+
+		//u is stretched back over [0, 1) each step, so it picks the whole way down
+		if (u < leftProbability) {
+			u /= leftProbability;
+			node = interior.left;
+			*probability *= (T)leftProbability;
+		}
+		else {
+			u = (u - leftProbability) / (1 - leftProbability);
+			node = interior.right;
+			*probability *= (T)(1 - leftProbability);
+		}
+		u = min(u, 1 - 1e-12);
+	}
+
+	//within the leaf, each light's falloff is taken in too, so lights which can't reach the point aren't picked
+	const BVHNode<T>& leaf = lightBVH->nodes[node];
+	T total = 0;
+	int i;
+	for (i = leaf.start; i < leaf.start + leaf.count; i++) {
+		const Light<T>& light = lights[lightBVH->primIndices[i]];
+		T distanceSquared = (light.position - point).squaredNorm();
+		total += light.colour.sum() * light.falloff(distanceSquared) / max(distanceSquared, (T)1);
+	}
+
+	//if none of them reach the point, this pick is dark
+	if (total <= 0)
+		return -1;
+
+	//if rounding leaves u * total just past the end, the last one with any importance takes it
+	double target = u * total;
+	int picked = -1;
+	T pickedImportance = 0;
+	for (i = leaf.start; i < leaf.start + leaf.count && target >= 0; i++) {
+		const Light<T>& light = lights[lightBVH->primIndices[i]];
+		T distanceSquared = (light.position - point).squaredNorm();
+		T importance = light.colour.sum() * light.falloff(distanceSquared) / max(distanceSquared, (T)1);
+		if (importance <= 0)
+			continue;
+
+		picked = lightBVH->primIndices[i];
+		pickedImportance = importance;
+		target -= importance;
+	}
+
+	*probability *= pickedImportance / total;
+	return picked;
+}
+
+//the lights with a radius as the boxes around their reach, in a grid like the spheres' one, so each cell lists the lights
+//which could reach any point in it (the lights without a radius are kept apart, they'd be in every cell)
+//the lights stay in order in both lists, so with no radii every point still visits them all in order
+template <typename T>
+void Scene<T>::buildLightGrid() {
+	vector<Box3<T> > reach;
+	for (unsigned int i = 0; i < lights.size(); i++) {
+		const Light<T>& light = lights[i];
+		if (light.radius > 0) {
+			Vec3<T> extent = Vec3<T>::Constant(light.radius);
+			reach.push_back(Box3<T>(light.position - extent, light.position + extent));
+			boundedLights.push_back(i);
+		}
+		else {
+			unboundedLights.push_back(i);
+		}
+	}
+
+	if (!reach.empty())
+		lightGrid = new Grid<T>(reach);
+}
+
+//which cluster of lightGrid point is in (-1 outside it, where only the lights without a radius reach)
+//found once per shading point, and passed to shadowRays and shadowRayLight
+template <typename T>
+int Scene<T>::lightCluster(const Vec3<T>& point) const {
+	if (lightGrid == NULL || !cullLights || lightSamples > 0)
+		return -1;
+	return lightGrid->cellAt(point);
+}
+
+//how many shadow rays each shading point in cluster gets
+template <typename T>
+int Scene<T>::shadowRays(int cluster) const {
+	if (lightSamples > 0)
+		return lightSamples;
+	if (lightGrid == NULL || !cullLights)
+		return lights.size();
+
+	int count = unboundedLights.size();
+	if (cluster >= 0)
+		count += lightGrid->cellStart[cluster + 1] - lightGrid->cellStart[cluster];
+	return count;
+}
+
+//which light a shading point's ray'th shadow ray goes to, and how much what it finds counts for (weight)
+//without lightSamples that's every light which could reach the point's cluster in turn, counting once; with it, lights are
+//picked by sampleLight, counting for the ones they stand for, so the light at the point is right on average (-1 if it's dark)
+//picks are hashed from the point, so the same point always gets the same lights, on any thread
+template <typename T>
+int Scene<T>::shadowRayLight(const Vec3<T>& point, const Vec3<T>& normal, int cluster, int ray, T* weight) const {
+	*weight = 1;
+	if (lightSamples <= 0) {
+		if (lightGrid == NULL || !cullLights)
+			return ray;
+		if (ray < (int)unboundedLights.size())
+			return unboundedLights[ray];
+		return boundedLights[lightGrid->cellItems[lightGrid->cellStart[cluster] + ray - unboundedLights.size()]];
+	}
+
+	unsigned long long hash = mixHash(0, ray);
+	for (int axis = 0; axis < 3; axis++) {
+		hash = mixHash(hash, scalarBits(point(axis)));
+		hash = mixHash(hash, scalarBits(normal(axis)));
+	}
+
+	T probability;
+	int light = sampleLight(point, hashToUnit(hash), &probability);
+	if (light >= 0)
+		*weight = 1 / (probability * lightSamples);
+	return light;
+}
+
+template class RayTracer::Material<float>;
+template class RayTracer::Material<double>;
+template class RayTracer::ShadowCache<float>;
+template class RayTracer::ShadowCache<double>;
+template class RayTracer::Light<float>;
+template class RayTracer::Light<double>;
+template class RayTracer::Scene<float>;
+template class RayTracer::Scene<double>;
@@ -0,0 +1,117 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <Eigen\Dense>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "Ray.h"
+#include "RayPacket.h"
+#include "SceneObject.h"
+#include "SphereArray.h"
+#include "PlaneArray.h"
+#include "TriangleArray.h"
+#include "InstanceArray.h"
+#include "BVH.h"
+#include "Grid.h"
+
+using namespace Eigen;
+
+namespace RayTracer {
+	template <typename T>
+	class Material {
+	public:
+		Material(const Vec3<T>& colour, T reflectivity);
+		Vec3<T> colour;
+		T reflectivity;
+	};
+
+	//a point light, which with a radius only reaches that far, fading out smoothly to nothing there
+	template <typename T>
+	class Light {
+	public:
+		Light(const Vec3<T>& position, const Vec3<T>& colour, T radius = 0);
+		T falloff(T distanceSquared) const;
+		Vec3<T> position;
+		Vec3<T> colour;
+		T radius; //0 for no falloff
+	};
+
+	//something found blocking a shadow ray, by which primitive array it's in and where
+	//(planes are never cached, there are only ever a few and they're tested first anyway)
+	enum OccluderType { OCCLUDER_NONE, OCCLUDER_SPHERE, OCCLUDER_INSTANCE };
+	struct Occluder {
+		OccluderType type;
+		int index;
+	};
+
+	//the last thing found blocking each light, for one thread's shadow rays (see Scene::occluded)
+	//neighbouring points are mostly blocked from a light by the same thing, so it's worth testing that before searching
+	//tests counts the shadow rays which had one to try, and hits how many of those it blocked
+	template <typename T>
+	class ShadowCache {
+	public:
+		ShadowCache(int lights = 0);
+
+		std::vector<Occluder> occluders; //one per light
+		long long tests;
+		long long hits;
+	};
+
+	//how the spheres are found: the BVH suits anything, the grid builds faster and suits dense fields of similar sized spheres
+	//SPHERE_LBVH is a BVH built from Morton codes, worse to trace than SPHERE_BVH but quick enough to rebuild every frame
+	enum SphereAccelerator { SPHERE_BVH, SPHERE_GRID, SPHERE_LBVH };
+
+	//the scene compiled from SceneObjects into flat arrays, one per type of primitive
+	//values are stored inline and objects refer to their material by index, so intersection
+	//is a tight loop over each array with no virtual calls or pointer chasing
+	//the SceneObjects are always double, the compiled scene is in whatever precision it's traced in
+	template <typename T>
+	class Scene {
+	public:
+		Scene(std::vector<SceneObject*>* objects, std::vector<SceneObject*>* lights, SphereAccelerator sphereAccelerator = SPHERE_BVH);
+		~Scene();
+		bool closestIntersection(Ray<T>* ray, Intersection<T>* intersection) const;
+		bool occluded(const Vec3<T>& origin, const Vec3<T>& direction, T tMax, Occluder* occluder = NULL) const;
+		bool occluded(const Vec3<T>& origin, const Vec3<T>& direction, T tMax, int light, ShadowCache<T>* cache) const;
+		void closestIntersections(RayPacket<T>* packet, Intersection<T>* intersections) const;
+		void updateSpheres(std::vector<SceneObject*>* objects);
+		int lightCluster(const Vec3<T>& point) const;
+		int shadowRays(int cluster) const;
+		int shadowRayLight(const Vec3<T>& point, const Vec3<T>& normal, int cluster, int ray, T* weight) const;
+		int sampleLight(const Vec3<T>& point, double u, T* probability) const;
+
+		SphereArray<T> spheres; //in BVH leaf order (when there is one)
+		PlaneArray<T> planes;
+		InstanceArray<T> instances; //every mesh, as an instance of its geometry, in instanceBVH leaf order
+		BVH<T>* instanceBVH;
+		std::vector<Material<T> > materials;
+		std::vector<Light<T> > lights;
+		BVH<T>* bvh; //over the spheres, only one of bvh and grid is built
+		Grid<T>* grid;
+		SphereAccelerator sphereAccelerator;
+		BVH<T>* lightBVH; //over the lights' positions (they're left in order, its leaves refer to them through primIndices)
+		std::vector<T> lightNodePower; //each lightBVH node's lights' colours, all added up
+		std::vector<T> lightNodeRadius; //how far past its bounds each lightBVH node's lights reach (infinite if any has no radius)
+		int lightSamples; //shadow rays per shading point, to lights picked from lightBVH (0 for one to every light)
+		Grid<T>* lightGrid; //over the reach of the lights with a radius, each cell (cluster) lists the ones which could light it
+		std::vector<int> boundedLights; //the lights with a radius, in the order lightGrid refers to them
+		std::vector<int> unboundedLights; //the lights without one, which reach every cluster
+		bool cullLights; //only visit the lights which could reach each point's cluster (without lightSamples)
+		bool cacheOccluders; //try the last thing which blocked each light first, when given a ShadowCache
+
+	private:
+		int addMaterial(SceneObject* object, std::unordered_multimap<unsigned long long, int>* materialIndices);
+		int addMesh(Mesh* mesh, std::map<Mesh*, int>* meshIndices);
+		void buildSphereAccelerator(const std::vector<Box3<T> >& sphereBounds, std::vector<int>* sphereOrder);
+		void buildLightBVH();
+		void buildLightGrid();
+		T lightImportance(int node, const Vec3<T>& point) const;
+		int closestSphere(Ray<T>* ray) const;
+		bool closestPlaneIntersection(Ray<T>* ray, Intersection<T>* intersection) const;
+		void fillSphereIntersection(int sphere, const Vec3<T>& origin, const Vec3<T>& direction, T t, Intersection<T>* intersection) const;
+		void fillTriangleIntersection(int instance, int triangle, const Vec3<T>& origin, const Vec3<T>& direction, T t, Intersection<T>* intersection) const;
+	};
+}
+
+#endif
@@ -12,10 +12,16 @@ SceneObject::SceneObject(Vector3d* position, Vector3d* colour) {
 	this->colour = colour;
 }
 
-//returns the intersection point and the normal, as a ray
-//if it doesn't intersect, then NULL
-Intersection* SceneObject::rayIntersect(Ray* ray) {
-	return NULL;
+//fills in the intersection's point, normal and t, and returns true
+//if it doesn't intersect within the ray's range, then false (and the intersection is left alone)
+bool SceneObject::rayIntersect(const Rayd&, Intersectiond*) {
+	return false;
+}
+
+//fills in the object's axis aligned bounding box
+//returns false if the object is unbounded (and so can't go in the BVH)
+bool SceneObject::getBounds(AlignedBox3d*) {
+	return false;
 }
 
 void SceneObject::printName() {
@@ -32,39 +38,52 @@ Sphere::Sphere(Vector3d* position, double radius, Vector3d* colour) : SceneObjec
 //based on
 //	http://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-sphere-intersection
 //
-Intersection* Sphere::rayIntersect(Ray* ray) {
+bool Sphere::rayIntersect(const Rayd& ray, Intersectiond* intersection) {
 	//the line from the ray's origin to the sphere's centre
-	Vector3d originToCentre = *(this->position) - *(ray->origin);
+	Vector3d originToCentre = *(this->position) - ray.origin;
 	//printf("    originToCentre: [%f, %f, %f] (%f)\n", originToCentre(0), originToCentre(1), originToCentre(2), originToCentre.norm());
 
 	//the point on the ray at which its distance to the sphere's centre is minimized
 	//(this forms a right triangle with originToCentre)
-	double rayLengthToMinimumDistance = originToCentre.dot(*(ray->direction));
+	double rayLengthToMinimumDistance = originToCentre.dot(ray.direction);
 	//printf("    rayLengthToMinimumDistance: %f\n", rayLengthToMinimumDistance);
 	if (rayLengthToMinimumDistance < 0)
-		return NULL;
+		return false;
+
+	//the near side of the sphere can't be any closer than this, so it's past the end of the ray
+	if (rayLengthToMinimumDistance - this->radius > ray.tMax)
+		return false;
 
-	//the minimum distance between the ray and the sphere's centre
+	//the minimum distance between the ray and the sphere's centre (squared)
 	//(b^2 = c^2 - a^2)
-	double rayDistanceToCentre = sqrt(pow(originToCentre.norm(), 2) - pow(rayLengthToMinimumDistance, 2));
-	//printf("    rayDistanceToCentre: %f\n", rayDistanceToCentre);
-	if (rayDistanceToCentre > this->radius)
-		return NULL;
+	double rayDistanceToCentreSquared = originToCentre.squaredNorm() - rayLengthToMinimumDistance * rayLengthToMinimumDistance;
+	double radiusSquared = this->radius * this->radius;
+	if (rayDistanceToCentreSquared > radiusSquared)
+		return false;
 
 	//the portion of the line segment which is inside the sphere
-	double insideLength = sqrt(pow(this->radius, 2) - pow(rayDistanceToCentre, 2));
+	double insideLength = sqrt(radiusSquared - rayDistanceToCentreSquared);
 	//printf("    insideLength: %f\n", insideLength);
 
 	//for this, only return the first point of intersection (don't render spheres which encompass the camera)
 	if (insideLength > rayLengthToMinimumDistance)
-		return NULL;
+		return false;
 
 	double rayDistance = rayLengthToMinimumDistance - insideLength;
+	if (rayDistance < ray.tMin || rayDistance > ray.tMax)
+		return false;
 
-	Vector3d* intersect = new Vector3d(*(ray->origin) + *(ray->direction) * rayDistance);
-	Vector3d* normal = new Vector3d((*intersect - *(this->position)).normalized());
+	intersection->point = ray.origin + ray.direction * rayDistance;
+	intersection->normal = (intersection->point - *(this->position)).normalized();
+	intersection->t = rayDistance;
+
+	return true;
+}
 
-	return new Intersection(this, intersect, normal);
+bool Sphere::getBounds(AlignedBox3d* bounds) {
+	Vector3d extent(this->radius, this->radius, this->radius);
+	*bounds = AlignedBox3d(*(this->position) - extent, *(this->position) + extent);
+	return true;
 }
 
 void Sphere::printName() {
@@ -78,23 +97,150 @@ Plane::Plane(Vector3d* position, Vector3d* normal, Vector3d* colour) : SceneObje
 	this->normal = normal;
 }
 
-Intersection* Plane::rayIntersect(Ray* ray) {
+bool Plane::rayIntersect(const Rayd& ray, Intersectiond* intersection) {
 	//dot product of the ray's direction and this plane's normal
-	double rayPlaneDot = (*(ray->direction)).dot(*(this->normal));
+	double rayPlaneDot = ray.direction.dot(*(this->normal));
 	if (rayPlaneDot == 0)
-		return NULL; //parallel, no intersection
+		return false; //parallel, no intersection
 
-	double rayDistance = (*(this->position) - *(ray->origin)).dot(*(this->normal)) / rayPlaneDot;
+	double rayDistance = (*(this->position) - ray.origin).dot(*(this->normal)) / rayPlaneDot;
 	if (rayDistance < 0)
-		return NULL; //behind us, don't care
+		return false; //behind us, don't care
+	if (rayDistance < ray.tMin || rayDistance > ray.tMax)
+		return false;
 	//printf("Intersect with plane at %f\n", rayDistance);
 
-	Vector3d* intersect = new Vector3d(*(ray->origin) + *(ray->direction) * rayDistance);
-	Vector3d* normal = new Vector3d(*(this->normal));
+	intersection->point = ray.origin + ray.direction * rayDistance;
+	intersection->normal = *(this->normal);
+	intersection->t = rayDistance;
 
-	return new Intersection(this, intersect, normal);
+	return true;
 }
 
 void Plane::printName() {
 	printf("PLANE");
-}
\ No newline at end of file
+}
+
+/*======
+ * MESH
+ *======*/
+Mesh::Mesh(Vector3d* colour) : SceneObject(new Vector3d(0, 0, 0), colour) {
+}
+
+int Mesh::triangleCount() {
+	return triangles.size() / 3;
+}
+
+//scales and moves the vertices so the mesh's bounds are centred on centre, with their longest side size long
+//(assets come in whatever units they were made in)
+void Mesh::fit(const Vector3d& centre, double size) {
+	AlignedBox3d bounds;
+	if (!getBounds(&bounds))
+		return;
+
+	double longestSide = bounds.sizes().maxCoeff();
+	double scale = longestSide > 0 ? size / longestSide : 1;
+	Vector3d oldCentre = bounds.center();
+
+	for (unsigned int i = 0; i < vertices.size(); i++)
+		vertices[i] = (vertices[i] - oldCentre) * scale + centre;
+
+	*(this->position) = centre;
+}
+
+//Moller-Trumbore against every triangle, the scene uses its own per-mesh BVH instead
+//triangles are two sided, the normal is flipped to face back along the ray
+bool Mesh::rayIntersect(const Rayd& ray, Intersectiond* intersection) {
+	bool hit = false;
+	double closest = ray.tMax;
+
+	for (int i = 0; i < triangleCount(); i++) {
+		const Vector3d& v0 = vertices[triangles[i * 3]];
+		Vector3d edge1 = vertices[triangles[i * 3 + 1]] - v0;
+		Vector3d edge2 = vertices[triangles[i * 3 + 2]] - v0;
+
+		Vector3d p = ray.direction.cross(edge2);
+		double determinant = edge1.dot(p);
+		if (determinant == 0)
+			continue; //parallel to the triangle
+
+		double inverseDeterminant = 1 / determinant;
+		Vector3d toOrigin = ray.origin - v0;
+		double u = toOrigin.dot(p) * inverseDeterminant;
+		if (u < 0 || u > 1)
+			continue;
+
+		Vector3d q = toOrigin.cross(edge1);
+		double v = ray.direction.dot(q) * inverseDeterminant;
+		if (v < 0 || u + v > 1)
+			continue;
+
+		double rayDistance = edge2.dot(q) * inverseDeterminant;
+		if (rayDistance < ray.tMin || rayDistance > closest)
+			continue;
+
+		closest = rayDistance;
+		hit = true;
+		intersection->point = ray.origin + ray.direction * rayDistance;
+		intersection->normal = edge1.cross(edge2).normalized();
+		if (intersection->normal.dot(ray.direction) > 0)
+			intersection->normal = -intersection->normal;
+		intersection->t = rayDistance;
+	}
+
+	return hit;
+}
+
+bool Mesh::getBounds(AlignedBox3d* bounds) {
+	if (vertices.size() == 0)
+		return false;
+
+	bounds->setEmpty();
+	for (unsigned int i = 0; i < vertices.size(); i++)
+		bounds->extend(vertices[i]);
+	return true;
+}
+
+void Mesh::printName() {
+	printf("MESH");
+}
+
+/*==========
+ * INSTANCE
+ *==========*/
+Instance::Instance(SceneObject* geometry, const Affine3d& transform, Vector3d* colour) : SceneObject(new Vector3d(transform.translation()), colour) {
+	this->geometry = geometry;
+	this->transform = transform;
+}
+
+//intersects the geometry with the ray moved into its space
+//the direction isn't renormalized there, so t is the same in both spaces
+bool Instance::rayIntersect(const Rayd& ray, Intersectiond* intersection) {
+	Affine3d inverse = transform.inverse();
+	Rayd objectRay(inverse * ray.origin, inverse.linear() * ray.direction, ray.tMin, ray.tMax);
+
+	Intersectiond objectIntersection;
+	if (!geometry->rayIntersect(objectRay, &objectIntersection))
+		return false;
+
+	intersection->point = ray.origin + ray.direction * objectIntersection.t;
+	intersection->normal = (inverse.linear().transpose() * objectIntersection.normal).normalized();
+	intersection->t = objectIntersection.t;
+
+	return true;
+}
+
+bool Instance::getBounds(AlignedBox3d* bounds) {
+	AlignedBox3d geometryBounds;
+	if (!geometry->getBounds(&geometryBounds))
+		return false;
+
+	bounds->setEmpty();
+	for (int corner = 0; corner < 8; corner++)
+		bounds->extend(transform * geometryBounds.corner((AlignedBox3d::CornerType)corner));
+	return true;
+}
+
+void Instance::printName() {
+	printf("INSTANCE");
+}
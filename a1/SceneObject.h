@@ -2,6 +2,7 @@
 #define SCENEOBJECT_H
 
 #include <Eigen\Dense>
+#include <vector>
 #include "Ray.h"
 
 using namespace Eigen;
@@ -10,10 +11,13 @@ namespace RayTracer {
 	class SceneObject {
 	public:
 		SceneObject(Vector3d* position, Vector3d* colour);
+		virtual ~SceneObject() {}
 		Vector3d* position;
 		Vector3d* colour;
 		double reflectivity = 0;
-		virtual Intersection* rayIntersect(Ray* ray);
+		double lightRadius = 0; //for lights, how far they reach (fading out smoothly on the way), 0 for everywhere
+		virtual bool rayIntersect(const Rayd& ray, Intersectiond* intersection);
+		virtual bool getBounds(AlignedBox3d* bounds);
 		virtual void printName();
 	};
 
@@ -22,7 +26,8 @@ namespace RayTracer {
 		double radius;
 
 		Sphere(Vector3d* position, double radius, Vector3d* colour);
-		Intersection* rayIntersect(Ray* ray);
+		bool rayIntersect(const Rayd& ray, Intersectiond* intersection);
+		bool getBounds(AlignedBox3d* bounds);
 		void printName();
 	};
 
@@ -31,7 +36,38 @@ namespace RayTracer {
 		Vector3d* normal;
 
 		Plane(Vector3d* position, Vector3d* normal, Vector3d* colour);
-		Intersection* rayIntersect(Ray* ray);
+		bool rayIntersect(const Rayd& ray, Intersectiond* intersection);
+		void printName();
+	};
+
+	//indexed triangle mesh, every three entries of triangles are one triangle's vertex indices
+	//vertices are in scene space, and position is kept at the centre of their bounds
+	class Mesh : public SceneObject {
+	public:
+		std::vector<Vector3d> vertices;
+		std::vector<int> triangles;
+
+		Mesh(Vector3d* colour);
+		int triangleCount();
+		void fit(const Vector3d& centre, double size);
+		bool rayIntersect(const Rayd& ray, Intersectiond* intersection);
+		bool getBounds(AlignedBox3d* bounds);
+		void printName();
+	};
+
+	//geometry placed in the scene by a transform, with its own colour and reflectivity
+	//any number of instances can share the same geometry, which the scene then stores only once
+	//(only meshes can be instanced, they're the only geometry big enough for it to matter)
+	class Instance : public SceneObject {
+	public:
+		EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+		SceneObject* geometry;
+		Affine3d transform; //geometry's space to scene space
+
+		Instance(SceneObject* geometry, const Affine3d& transform, Vector3d* colour);
+		bool rayIntersect(const Rayd& ray, Intersectiond* intersection);
+		bool getBounds(AlignedBox3d* bounds);
 		void printName();
 	};
 }
@@ -0,0 +1,326 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cmath>
+
+//how many doubles/floats are processed per instruction
+//picked at compile time from the instruction sets the compiler is allowed to use
+#if defined(__AVX__)
+#define SIMD_DOUBLE_WIDTH 4
+#define SIMD_FLOAT_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_DOUBLE_WIDTH 2
+#define SIMD_FLOAT_WIDTH 4
+#else
+#define SIMD_DOUBLE_WIDTH 1
+#define SIMD_FLOAT_WIDTH 1
+#endif
+
+#if SIMD_DOUBLE_WIDTH > 1
+#include <immintrin.h>
+#endif
+
+namespace RayTracer {
+	//result of comparing SimdDoubles, one flag per lane
+	class SimdDoubleMask {
+	public:
+#if SIMD_DOUBLE_WIDTH == 4
+		__m256d v;
+		SimdDoubleMask(__m256d v) : v(v) {}
+		bool any() const { return _mm256_movemask_pd(v) != 0; }
+		int bits() const { return _mm256_movemask_pd(v); }
+#elif SIMD_DOUBLE_WIDTH == 2
+		__m128d v;
+		SimdDoubleMask(__m128d v) : v(v) {}
+		bool any() const { return _mm_movemask_pd(v) != 0; }
+		int bits() const { return _mm_movemask_pd(v); }
+#else
+		bool v;
+		SimdDoubleMask(bool v) : v(v) {}
+		bool any() const { return v; }
+		int bits() const { return v ? 1 : 0; }
+#endif
+	};
+
+	//SIMD_DOUBLE_WIDTH doubles, so kernels can be written once for any instruction set
+	class SimdDouble {
+	public:
+#if SIMD_DOUBLE_WIDTH == 4
+		__m256d v;
+		SimdDouble() {}
+		SimdDouble(__m256d v) : v(v) {}
+		SimdDouble(double d) : v(_mm256_set1_pd(d)) {}
+		static SimdDouble load(const double* p) { return _mm256_loadu_pd(p); }
+		static SimdDouble lanes(double first) { return _mm256_set_pd(first + 3, first + 2, first + 1, first); }
+		void store(double* p) const { _mm256_storeu_pd(p, v); }
+#elif SIMD_DOUBLE_WIDTH == 2
+		__m128d v;
+		SimdDouble() {}
+		SimdDouble(__m128d v) : v(v) {}
+		SimdDouble(double d) : v(_mm_set1_pd(d)) {}
+		static SimdDouble load(const double* p) { return _mm_loadu_pd(p); }
+		static SimdDouble lanes(double first) { return _mm_set_pd(first + 1, first); }
+		void store(double* p) const { _mm_storeu_pd(p, v); }
+#else
+		double v;
+		SimdDouble() {}
+		SimdDouble(double d) : v(d) {}
+		static SimdDouble load(const double* p) { return *p; }
+		static SimdDouble lanes(double first) { return first; }
+		void store(double* p) const { *p = v; }
+#endif
+	};
+
+#if SIMD_DOUBLE_WIDTH == 4
+	inline SimdDouble operator+(SimdDouble a, SimdDouble b) { return _mm256_add_pd(a.v, b.v); }
+	inline SimdDouble operator-(SimdDouble a, SimdDouble b) { return _mm256_sub_pd(a.v, b.v); }
+	inline SimdDouble operator*(SimdDouble a, SimdDouble b) { return _mm256_mul_pd(a.v, b.v); }
+	inline SimdDouble operator/(SimdDouble a, SimdDouble b) { return _mm256_div_pd(a.v, b.v); }
+	inline SimdDouble simdMin(SimdDouble a, SimdDouble b) { return _mm256_min_pd(a.v, b.v); }
+	inline SimdDouble simdMax(SimdDouble a, SimdDouble b) { return _mm256_max_pd(a.v, b.v); }
+	inline SimdDouble simdSqrt(SimdDouble a) { return _mm256_sqrt_pd(a.v); }
+	inline SimdDoubleMask operator<(SimdDouble a, SimdDouble b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ); }
+	inline SimdDoubleMask operator<=(SimdDouble a, SimdDouble b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ); }
+	inline SimdDoubleMask operator>=(SimdDouble a, SimdDouble b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ); }
+	inline SimdDoubleMask operator!=(SimdDouble a, SimdDouble b) { return _mm256_cmp_pd(a.v, b.v, _CMP_NEQ_OQ); }
+	inline SimdDoubleMask operator&(SimdDoubleMask a, SimdDoubleMask b) { return _mm256_and_pd(a.v, b.v); }
+	inline SimdDoubleMask operator|(SimdDoubleMask a, SimdDoubleMask b) { return _mm256_or_pd(a.v, b.v); }
+	inline SimdDouble select(SimdDoubleMask mask, SimdDouble a, SimdDouble b) { return _mm256_blendv_pd(b.v, a.v, mask.v); }
+#elif SIMD_DOUBLE_WIDTH == 2
+	inline SimdDouble operator+(SimdDouble a, SimdDouble b) { return _mm_add_pd(a.v, b.v); }
+	inline SimdDouble operator-(SimdDouble a, SimdDouble b) { return _mm_sub_pd(a.v, b.v); }
+	inline SimdDouble operator*(SimdDouble a, SimdDouble b) { return _mm_mul_pd(a.v, b.v); }
+	inline SimdDouble operator/(SimdDouble a, SimdDouble b) { return _mm_div_pd(a.v, b.v); }
+	inline SimdDouble simdMin(SimdDouble a, SimdDouble b) { return _mm_min_pd(a.v, b.v); }
+	inline SimdDouble simdMax(SimdDouble a, SimdDouble b) { return _mm_max_pd(a.v, b.v); }
+	inline SimdDouble simdSqrt(SimdDouble a) { return _mm_sqrt_pd(a.v); }
+	inline SimdDoubleMask operator<(SimdDouble a, SimdDouble b) { return _mm_cmplt_pd(a.v, b.v); }
+	inline SimdDoubleMask operator<=(SimdDouble a, SimdDouble b) { return _mm_cmple_pd(a.v, b.v); }
+	inline SimdDoubleMask operator>=(SimdDouble a, SimdDouble b) { return _mm_cmpge_pd(a.v, b.v); }
+	inline SimdDoubleMask operator!=(SimdDouble a, SimdDouble b) { return _mm_cmpneq_pd(a.v, b.v); }
+	inline SimdDoubleMask operator&(SimdDoubleMask a, SimdDoubleMask b) { return _mm_and_pd(a.v, b.v); }
+	inline SimdDoubleMask operator|(SimdDoubleMask a, SimdDoubleMask b) { return _mm_or_pd(a.v, b.v); }
+	//no blend instruction before SSE4.1
+	inline SimdDouble select(SimdDoubleMask mask, SimdDouble a, SimdDouble b) { return _mm_or_pd(_mm_and_pd(mask.v, a.v), _mm_andnot_pd(mask.v, b.v)); }
+#else
+	inline SimdDouble operator+(SimdDouble a, SimdDouble b) { return a.v + b.v; }
+	inline SimdDouble operator-(SimdDouble a, SimdDouble b) { return a.v - b.v; }
+	inline SimdDouble operator*(SimdDouble a, SimdDouble b) { return a.v * b.v; }
+	inline SimdDouble operator/(SimdDouble a, SimdDouble b) { return a.v / b.v; }
+	inline SimdDouble simdMin(SimdDouble a, SimdDouble b) { return a.v < b.v ? a.v : b.v; }
+	inline SimdDouble simdMax(SimdDouble a, SimdDouble b) { return a.v > b.v ? a.v : b.v; }
+	inline SimdDouble simdSqrt(SimdDouble a) { return std::sqrt(a.v); }
+	inline SimdDoubleMask operator<(SimdDouble a, SimdDouble b) { return a.v < b.v; }
+	inline SimdDoubleMask operator<=(SimdDouble a, SimdDouble b) { return a.v <= b.v; }
+	inline SimdDoubleMask operator>=(SimdDouble a, SimdDouble b) { return a.v >= b.v; }
+	inline SimdDoubleMask operator!=(SimdDouble a, SimdDouble b) { return a.v != b.v; }
+	inline SimdDoubleMask operator&(SimdDoubleMask a, SimdDoubleMask b) { return a.v && b.v; }
+	inline SimdDoubleMask operator|(SimdDoubleMask a, SimdDoubleMask b) { return a.v || b.v; }
+	inline SimdDouble select(SimdDoubleMask mask, SimdDouble a, SimdDouble b) { return mask.v ? a.v : b.v; }
+#endif
+
+	//one int per SimdDouble lane, for carrying primitive indices alongside the doubles they were picked by
+	//(indices kept in floating point lanes stop being exact past 2^24 in floats)
+	class SimdDoubleIndex {
+	public:
+#if SIMD_DOUBLE_WIDTH == 4
+		__m128i v;
+		SimdDoubleIndex() {}
+		SimdDoubleIndex(__m128i v) : v(v) {}
+		SimdDoubleIndex(int i) : v(_mm_set1_epi32(i)) {}
+		static SimdDoubleIndex load(const int* p) { return _mm_loadu_si128((const __m128i*)p); }
+		static SimdDoubleIndex lanes(int first) { return _mm_set_epi32(first + 3, first + 2, first + 1, first); }
+		void store(int* p) const { _mm_storeu_si128((__m128i*)p, v); }
+#elif SIMD_DOUBLE_WIDTH == 2
+		//only the low two ints are used
+		__m128i v;
+		SimdDoubleIndex() {}
+		SimdDoubleIndex(__m128i v) : v(v) {}
+		SimdDoubleIndex(int i) : v(_mm_set1_epi32(i)) {}
+		static SimdDoubleIndex load(const int* p) { return _mm_loadl_epi64((const __m128i*)p); }
+		static SimdDoubleIndex lanes(int first) { return _mm_set_epi32(0, 0, first + 1, first); }
+		void store(int* p) const { _mm_storel_epi64((__m128i*)p, v); }
+#else
+		int v;
+		SimdDoubleIndex() {}
+		SimdDoubleIndex(int i) : v(i) {}
+		static SimdDoubleIndex load(const int* p) { return *p; }
+		static SimdDoubleIndex lanes(int first) { return first; }
+		void store(int* p) const { *p = v; }
+#endif
+	};
+
+	//the double mask has 64 bits per lane, so it's narrowed to 32 (taking the low half of each) before blending ints
+#if SIMD_DOUBLE_WIDTH == 4
+	inline SimdDoubleIndex select(SimdDoubleMask mask, SimdDoubleIndex a, SimdDoubleIndex b) {
+		__m128 narrow = _mm_shuffle_ps(_mm_castpd_ps(_mm256_castpd256_pd128(mask.v)), _mm_castpd_ps(_mm256_extractf128_pd(mask.v, 1)), _MM_SHUFFLE(2, 0, 2, 0));
+		return _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(b.v), _mm_castsi128_ps(a.v), narrow));
+	}
+#elif SIMD_DOUBLE_WIDTH == 2
+	inline SimdDoubleIndex select(SimdDoubleMask mask, SimdDoubleIndex a, SimdDoubleIndex b) {
+		__m128i narrow = _mm_castps_si128(_mm_shuffle_ps(_mm_castpd_ps(mask.v), _mm_castpd_ps(mask.v), _MM_SHUFFLE(2, 0, 2, 0)));
+		return _mm_or_si128(_mm_and_si128(narrow, a.v), _mm_andnot_si128(narrow, b.v));
+	}
+#else
+	inline SimdDoubleIndex select(SimdDoubleMask mask, SimdDoubleIndex a, SimdDoubleIndex b) { return mask.v ? a.v : b.v; }
+#endif
+
+	//SIMD_FLOAT_WIDTH floats, the same operations as SimdDouble
+	class SimdFloatMask {
+	public:
+#if SIMD_FLOAT_WIDTH == 8
+		__m256 v;
+		SimdFloatMask(__m256 v) : v(v) {}
+		bool any() const { return _mm256_movemask_ps(v) != 0; }
+		int bits() const { return _mm256_movemask_ps(v); }
+#elif SIMD_FLOAT_WIDTH == 4
+		__m128 v;
+		SimdFloatMask(__m128 v) : v(v) {}
+		bool any() const { return _mm_movemask_ps(v) != 0; }
+		int bits() const { return _mm_movemask_ps(v); }
+#else
+		bool v;
+		SimdFloatMask(bool v) : v(v) {}
+		bool any() const { return v; }
+		int bits() const { return v ? 1 : 0; }
+#endif
+	};
+
+	class SimdFloat {
+	public:
+#if SIMD_FLOAT_WIDTH == 8
+		__m256 v;
+		SimdFloat() {}
+		SimdFloat(__m256 v) : v(v) {}
+		SimdFloat(float f) : v(_mm256_set1_ps(f)) {}
+		static SimdFloat load(const float* p) { return _mm256_loadu_ps(p); }
+		static SimdFloat lanes(float first) { return _mm256_set_ps(first + 7, first + 6, first + 5, first + 4, first + 3, first + 2, first + 1, first); }
+		void store(float* p) const { _mm256_storeu_ps(p, v); }
+#elif SIMD_FLOAT_WIDTH == 4
+		__m128 v;
+		SimdFloat() {}
+		SimdFloat(__m128 v) : v(v) {}
+		SimdFloat(float f) : v(_mm_set1_ps(f)) {}
+		static SimdFloat load(const float* p) { return _mm_loadu_ps(p); }
+		static SimdFloat lanes(float first) { return _mm_set_ps(first + 3, first + 2, first + 1, first); }
+		void store(float* p) const { _mm_storeu_ps(p, v); }
+#else
+		float v;
+		SimdFloat() {}
+		SimdFloat(float f) : v(f) {}
+		static SimdFloat load(const float* p) { return *p; }
+		static SimdFloat lanes(float first) { return first; }
+		void store(float* p) const { *p = v; }
+#endif
+	};
+
+#if SIMD_FLOAT_WIDTH == 8
+	inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return _mm256_add_ps(a.v, b.v); }
+	inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return _mm256_sub_ps(a.v, b.v); }
+	inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return _mm256_mul_ps(a.v, b.v); }
+	inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return _mm256_div_ps(a.v, b.v); }
+	inline SimdFloat simdMin(SimdFloat a, SimdFloat b) { return _mm256_min_ps(a.v, b.v); }
+	inline SimdFloat simdMax(SimdFloat a, SimdFloat b) { return _mm256_max_ps(a.v, b.v); }
+	inline SimdFloat simdSqrt(SimdFloat a) { return _mm256_sqrt_ps(a.v); }
+	inline SimdFloatMask operator<(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+	inline SimdFloatMask operator<=(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+	inline SimdFloatMask operator>=(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+	inline SimdFloatMask operator!=(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_OQ); }
+	inline SimdFloatMask operator&(SimdFloatMask a, SimdFloatMask b) { return _mm256_and_ps(a.v, b.v); }
+	inline SimdFloatMask operator|(SimdFloatMask a, SimdFloatMask b) { return _mm256_or_ps(a.v, b.v); }
+	inline SimdFloat select(SimdFloatMask mask, SimdFloat a, SimdFloat b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+#elif SIMD_FLOAT_WIDTH == 4
+	inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return _mm_add_ps(a.v, b.v); }
+	inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return _mm_sub_ps(a.v, b.v); }
+	inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return _mm_mul_ps(a.v, b.v); }
+	inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return _mm_div_ps(a.v, b.v); }
+	inline SimdFloat simdMin(SimdFloat a, SimdFloat b) { return _mm_min_ps(a.v, b.v); }
+	inline SimdFloat simdMax(SimdFloat a, SimdFloat b) { return _mm_max_ps(a.v, b.v); }
+	inline SimdFloat simdSqrt(SimdFloat a) { return _mm_sqrt_ps(a.v); }
+	inline SimdFloatMask operator<(SimdFloat a, SimdFloat b) { return _mm_cmplt_ps(a.v, b.v); }
+	inline SimdFloatMask operator<=(SimdFloat a, SimdFloat b) { return _mm_cmple_ps(a.v, b.v); }
+	inline SimdFloatMask operator>=(SimdFloat a, SimdFloat b) { return _mm_cmpge_ps(a.v, b.v); }
+	inline SimdFloatMask operator!=(SimdFloat a, SimdFloat b) { return _mm_cmpneq_ps(a.v, b.v); }
+	inline SimdFloatMask operator&(SimdFloatMask a, SimdFloatMask b) { return _mm_and_ps(a.v, b.v); }
+	inline SimdFloatMask operator|(SimdFloatMask a, SimdFloatMask b) { return _mm_or_ps(a.v, b.v); }
+	inline SimdFloat select(SimdFloatMask mask, SimdFloat a, SimdFloat b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+#else
+	inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return a.v + b.v; }
+	inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return a.v - b.v; }
+	inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return a.v * b.v; }
+	inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return a.v / b.v; }
+	inline SimdFloat simdMin(SimdFloat a, SimdFloat b) { return a.v < b.v ? a.v : b.v; }
+	inline SimdFloat simdMax(SimdFloat a, SimdFloat b) { return a.v > b.v ? a.v : b.v; }
+	inline SimdFloat simdSqrt(SimdFloat a) { return std::sqrt(a.v); }
+	inline SimdFloatMask operator<(SimdFloat a, SimdFloat b) { return a.v < b.v; }
+	inline SimdFloatMask operator<=(SimdFloat a, SimdFloat b) { return a.v <= b.v; }
+	inline SimdFloatMask operator>=(SimdFloat a, SimdFloat b) { return a.v >= b.v; }
+	inline SimdFloatMask operator!=(SimdFloat a, SimdFloat b) { return a.v != b.v; }
+	inline SimdFloatMask operator&(SimdFloatMask a, SimdFloatMask b) { return a.v && b.v; }
+	inline SimdFloatMask operator|(SimdFloatMask a, SimdFloatMask b) { return a.v || b.v; }
+	inline SimdFloat select(SimdFloatMask mask, SimdFloat a, SimdFloat b) { return mask.v ? a.v : b.v; }
+#endif
+
+	//one int per SimdFloat lane, the same as SimdDoubleIndex
+	//only AVX's float operations are used on the 256 bit lanes, so this doesn't need AVX2
+	class SimdFloatIndex {
+	public:
+#if SIMD_FLOAT_WIDTH == 8
+		__m256i v;
+		SimdFloatIndex() {}
+		SimdFloatIndex(__m256i v) : v(v) {}
+		SimdFloatIndex(int i) : v(_mm256_set1_epi32(i)) {}
+		static SimdFloatIndex load(const int* p) { return _mm256_loadu_si256((const __m256i*)p); }
+		static SimdFloatIndex lanes(int first) { return _mm256_set_epi32(first + 7, first + 6, first + 5, first + 4, first + 3, first + 2, first + 1, first); }
+		void store(int* p) const { _mm256_storeu_si256((__m256i*)p, v); }
+#elif SIMD_FLOAT_WIDTH == 4
+		__m128i v;
+		SimdFloatIndex() {}
+		SimdFloatIndex(__m128i v) : v(v) {}
+		SimdFloatIndex(int i) : v(_mm_set1_epi32(i)) {}
+		static SimdFloatIndex load(const int* p) { return _mm_loadu_si128((const __m128i*)p); }
+		static SimdFloatIndex lanes(int first) { return _mm_set_epi32(first + 3, first + 2, first + 1, first); }
+		void store(int* p) const { _mm_storeu_si128((__m128i*)p, v); }
+#else
+		int v;
+		SimdFloatIndex() {}
+		SimdFloatIndex(int i) : v(i) {}
+		static SimdFloatIndex load(const int* p) { return *p; }
+		static SimdFloatIndex lanes(int first) { return first; }
+		void store(int* p) const { *p = v; }
+#endif
+	};
+
+#if SIMD_FLOAT_WIDTH == 8
+	inline SimdFloatIndex select(SimdFloatMask mask, SimdFloatIndex a, SimdFloatIndex b) { return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b.v), _mm256_castsi256_ps(a.v), mask.v)); }
+#elif SIMD_FLOAT_WIDTH == 4
+	inline SimdFloatIndex select(SimdFloatMask mask, SimdFloatIndex a, SimdFloatIndex b) {
+		__m128i bits = _mm_castps_si128(mask.v);
+		return _mm_or_si128(_mm_and_si128(bits, a.v), _mm_andnot_si128(bits, b.v));
+	}
+#else
+	inline SimdFloatIndex select(SimdFloatMask mask, SimdFloatIndex a, SimdFloatIndex b) { return mask.v ? a.v : b.v; }
+#endif
+
+	//picks the SIMD type for a scalar type, so kernels can be templated on float/double
+	template <typename T>
+	struct Simd;
+
+	template <>
+	struct Simd<double> {
+		typedef SimdDouble Type;
+		typedef SimdDoubleMask Mask;
+		typedef SimdDoubleIndex Index;
+		enum { WIDTH = SIMD_DOUBLE_WIDTH };
+	};
+
+	template <>
+	struct Simd<float> {
+		typedef SimdFloat Type;
+		typedef SimdFloatMask Mask;
+		typedef SimdFloatIndex Index;
+		enum { WIDTH = SIMD_FLOAT_WIDTH };
+	};
+}
+
+#endif
@@ -0,0 +1,170 @@
+#include "SphereArray.h"
+#include <cmath>
+#include "Simd.h"
+
+using namespace RayTracer;
+using namespace Eigen;
+
+template <typename T>
+SphereArray<T>::SphereArray() {
+}
+
+template <typename T>
+void SphereArray<T>::add(const Vec3<T>& centre, T radius, int material, int object) {
+	this->x.push_back(centre(0));
+	this->y.push_back(centre(1));
+	this->z.push_back(centre(2));
+	this->radius.push_back(radius);
+	this->radiusSquared.push_back(radius * radius);
+	this->material.push_back(material);
+	this->object.push_back(object);
+}
+
+template <typename T>
+int SphereArray<T>::size() const {
+	return x.size();
+}
+
+//returns the index of the nearest sphere in [start, start + count) hit within the ray's range, or -1
+//t is set to the distance to it
+//
+//this is the same test as Sphere::rayIntersect, written as a discriminant so it has no branches:
+//with b = (centre - origin).direction, the near hit is at b - sqrt(r^2 - |centre - origin|^2 + b^2)
+//(rays starting inside a sphere don't hit it, since that puts the near hit behind the origin)
+template <typename T>
+int SphereArray<T>::intersect(const Ray<T>& ray, int start, int count, T* t) const {
+	typedef typename Simd<T>::Type SimdT;
+	typedef typename Simd<T>::Mask SimdMask;
+	typedef typename Simd<T>::Index SimdIndex;
+	const int width = Simd<T>::WIDTH;
+
+	int i = start;
+	int end = start + count;
+	T bestT = ray.tMax;
+	int bestIndex = -1;
+
+	SimdT originX(ray.origin(0)), originY(ray.origin(1)), originZ(ray.origin(2));
+	SimdT directionX(ray.direction(0)), directionY(ray.direction(1)), directionZ(ray.direction(2));
+	SimdT tMin(ray.tMin);
+	SimdT zero((T)0);
+	SimdT laneBestT(bestT);
+	SimdIndex laneBestIndex(-1);
+
+	for (; i + width <= end; i += width) {
+		SimdT toCentreX = SimdT::load(&x[i]) - originX;
+		SimdT toCentreY = SimdT::load(&y[i]) - originY;
+		SimdT toCentreZ = SimdT::load(&z[i]) - originZ;
+
+		SimdT b = toCentreX * directionX + toCentreY * directionY + toCentreZ * directionZ;
+		SimdT distanceSquared = toCentreX * toCentreX + toCentreY * toCentreY + toCentreZ * toCentreZ;
+		SimdT discriminant = SimdT::load(&radiusSquared[i]) - distanceSquared + b * b;
+		SimdT hitT = b - simdSqrt(simdMax(discriminant, zero));
+
+		SimdMask mask = (discriminant >= zero) & (hitT >= tMin) & (hitT <= laneBestT);
+		laneBestT = select(mask, hitT, laneBestT);
+		laneBestIndex = select(mask, SimdIndex::lanes(i), laneBestIndex);
+	}
+
+	T lanesT[width];
+	int lanesIndex[width];
+	laneBestT.store(lanesT);
+	laneBestIndex.store(lanesIndex);
+	for (int lane = 0; lane < width; lane++) {
+		if (lanesIndex[lane] >= 0 && lanesT[lane] <= bestT) {
+			bestT = lanesT[lane];
+			bestIndex = lanesIndex[lane];
+		}
+	}
+
+	//whatever didn't fill a full set of lanes
+	for (; i < end; i++) {
+		T hitT;
+		if (intersectSphere(ray, i, bestT, &hitT)) {
+			bestT = hitT;
+			bestIndex = i;
+		}
+	}
+
+	*t = bestT;
+	return bestIndex;
+}
+
+//whether any sphere in [start, start + count) is hit within the ray's range
+//stops at the first set of lanes with a hit, since it doesn't matter which one it is
+template <typename T>
+bool SphereArray<T>::intersectsAny(const Ray<T>& ray, int start, int count) const {
+	typedef typename Simd<T>::Type SimdT;
+	const int width = Simd<T>::WIDTH;
+
+	int i = start;
+	int end = start + count;
+
+	SimdT originX(ray.origin(0)), originY(ray.origin(1)), originZ(ray.origin(2));
+	SimdT directionX(ray.direction(0)), directionY(ray.direction(1)), directionZ(ray.direction(2));
+	SimdT tMin(ray.tMin), tMax(ray.tMax);
+	SimdT zero((T)0);
+
+	for (; i + width <= end; i += width) {
+		SimdT toCentreX = SimdT::load(&x[i]) - originX;
+		SimdT toCentreY = SimdT::load(&y[i]) - originY;
+		SimdT toCentreZ = SimdT::load(&z[i]) - originZ;
+
+		SimdT b = toCentreX * directionX + toCentreY * directionY + toCentreZ * directionZ;
+		SimdT distanceSquared = toCentreX * toCentreX + toCentreY * toCentreY + toCentreZ * toCentreZ;
+		SimdT discriminant = SimdT::load(&radiusSquared[i]) - distanceSquared + b * b;
+		SimdT hitT = b - simdSqrt(simdMax(discriminant, zero));
+
+		if (((discriminant >= zero) & (hitT >= tMin) & (hitT <= tMax)).any())
+			return true;
+	}
+
+	for (; i < end; i++) {
+		T hitT;
+		if (intersectSphere(ray, i, ray.tMax, &hitT))
+			return true;
+	}
+
+	return false;
+}
+
+//tests every ray in the packet against spheres [start, start + count), one sphere at a time across the rays
+//shrinks each ray's tMax and records which sphere it hit
+template <typename T>
+void SphereArray<T>::intersectPacket(RayPacket<T>* packet, int start, int count, int* hitSpheres) const {
+	typedef typename Simd<T>::Type SimdT;
+	typedef typename Simd<T>::Mask SimdMask;
+	typedef typename Simd<T>::Index SimdIndex;
+	const int width = Simd<T>::WIDTH;
+
+	SimdT zero((T)0);
+
+	for (int sphere = start; sphere < start + count; sphere++) {
+		SimdT centreX(x[sphere]), centreY(y[sphere]), centreZ(z[sphere]);
+		SimdT sphereRadiusSquared(radiusSquared[sphere]);
+		SimdIndex sphereIndex(sphere);
+
+		for (int i = 0; i < PACKET_SIZE; i += width) {
+			SimdT toCentreX = centreX - SimdT::load(&packet->originX[i]);
+			SimdT toCentreY = centreY - SimdT::load(&packet->originY[i]);
+			SimdT toCentreZ = centreZ - SimdT::load(&packet->originZ[i]);
+			SimdT tMax = SimdT::load(&packet->tMax[i]);
+
+			SimdT b = toCentreX * SimdT::load(&packet->directionX[i])
+				+ toCentreY * SimdT::load(&packet->directionY[i])
+				+ toCentreZ * SimdT::load(&packet->directionZ[i]);
+			SimdT distanceSquared = toCentreX * toCentreX + toCentreY * toCentreY + toCentreZ * toCentreZ;
+			SimdT discriminant = sphereRadiusSquared - distanceSquared + b * b;
+			SimdT hitT = b - simdSqrt(simdMax(discriminant, zero));
+
+			SimdMask mask = (discriminant >= zero) & (hitT >= SimdT::load(&packet->tMin[i])) & (hitT <= tMax);
+			if (!mask.any())
+				continue;
+
+			select(mask, hitT, tMax).store(&packet->tMax[i]);
+			select(mask, sphereIndex, SimdIndex::load(&hitSpheres[i])).store(&hitSpheres[i]);
+		}
+	}
+}
+
+template class RayTracer::SphereArray<float>;
+template class RayTracer::SphereArray<double>;
@@ -0,0 +1,51 @@
+#ifndef SPHEREARRAY_H
+#define SPHEREARRAY_H
+
+#include <Eigen\Dense>
+#include <cmath>
+#include "Ray.h"
+#include "RayPacket.h"
+#include "AlignedAllocator.h"
+
+using namespace Eigen;
+
+namespace RayTracer {
+	//sphere centres and radii as structure-of-arrays, so one ray can be tested against several spheres at once
+	//(Simd<T>::WIDTH of them per instruction)
+	template <typename T>
+	class SphereArray {
+	public:
+		SphereArray();
+		void add(const Vec3<T>& centre, T radius, int material, int object);
+		int size() const;
+		int intersect(const Ray<T>& ray, int start, int count, T* t) const;
+		bool intersectsAny(const Ray<T>& ray, int start, int count) const;
+		void intersectPacket(RayPacket<T>* packet, int start, int count, int* hitSpheres) const;
+
+		//one sphere, for callers which don't have them in contiguous runs (and the ends of the runs above)
+		//the near hit if it's in [tMin, tMax]; here so it can be inlined into the loops calling it
+		bool intersectSphere(const Ray<T>& ray, int sphere, T tMax, T* t) const {
+			T toCentreX = x[sphere] - ray.origin(0);
+			T toCentreY = y[sphere] - ray.origin(1);
+			T toCentreZ = z[sphere] - ray.origin(2);
+			T b = toCentreX * ray.direction(0) + toCentreY * ray.direction(1) + toCentreZ * ray.direction(2);
+			T distanceSquared = toCentreX * toCentreX + toCentreY * toCentreY + toCentreZ * toCentreZ;
+			T discriminant = radiusSquared[sphere] - distanceSquared + b * b;
+			if (discriminant < 0)
+				return false;
+
+			*t = b - std::sqrt(discriminant);
+			return *t >= ray.tMin && *t <= tMax;
+		}
+
+		AlignedArray<T> x;
+		AlignedArray<T> y;
+		AlignedArray<T> z;
+		AlignedArray<T> radius;
+		AlignedArray<T> radiusSquared;
+		AlignedArray<int> material;
+		AlignedArray<int> object; //index in the object list the scene was built from
+	};
+}
+
+#endif
@@ -0,0 +1,233 @@
+#include "TriangleArray.h"
+#include "Simd.h"
+
+using namespace RayTracer;
+using namespace Eigen;
+
+template <typename T>
+TriangleArray<T>::TriangleArray() {
+}
+
+template <typename T>
+void TriangleArray<T>::add(const Vec3<T>& v0, const Vec3<T>& v1, const Vec3<T>& v2) {
+	Vec3<T> edge1 = v1 - v0;
+	Vec3<T> edge2 = v2 - v0;
+
+	this->x.push_back(v0(0));
+	this->y.push_back(v0(1));
+	this->z.push_back(v0(2));
+	this->edge1X.push_back(edge1(0));
+	this->edge1Y.push_back(edge1(1));
+	this->edge1Z.push_back(edge1(2));
+	this->edge2X.push_back(edge2(0));
+	this->edge2Y.push_back(edge2(1));
+	this->edge2Z.push_back(edge2(2));
+}
+
+template <typename T>
+int TriangleArray<T>::size() const {
+	return x.size();
+}
+
+//geometric normal, not facing any particular way (triangles are two sided)
+template <typename T>
+Vec3<T> TriangleArray<T>::normal(int triangle) const {
+	Vec3<T> edge1(edge1X[triangle], edge1Y[triangle], edge1Z[triangle]);
+	Vec3<T> edge2(edge2X[triangle], edge2Y[triangle], edge2Z[triangle]);
+	return edge1.cross(edge2).normalized();
+}
+
+//returns the index of the nearest triangle in [start, start + count) hit within the ray's range, or -1
+//t is set to the distance to it
+//
+//Moller-Trumbore, with the triangles across the SIMD lanes like SphereArray::intersect
+//misses (including rays parallel to the triangle, where the determinant is 0 and everything goes inf/nan)
+//just fail the barycentric or range tests, so there are no branches per triangle
+template <typename T>
+int TriangleArray<T>::intersect(const Ray<T>& ray, int start, int count, T* t) const {
+	typedef typename Simd<T>::Type SimdT;
+	typedef typename Simd<T>::Mask SimdMask;
+	typedef typename Simd<T>::Index SimdIndex;
+	const int width = Simd<T>::WIDTH;
+
+	int i = start;
+	int end = start + count;
+	T bestT = ray.tMax;
+	int bestIndex = -1;
+
+	SimdT originX(ray.origin(0)), originY(ray.origin(1)), originZ(ray.origin(2));
+	SimdT directionX(ray.direction(0)), directionY(ray.direction(1)), directionZ(ray.direction(2));
+	SimdT tMin(ray.tMin);
+	SimdT zero((T)0), one((T)1);
+	SimdT laneBestT(bestT);
+	SimdIndex laneBestIndex(-1);
+
+	for (; i + width <= end; i += width) {
+		SimdT e1X = SimdT::load(&edge1X[i]), e1Y = SimdT::load(&edge1Y[i]), e1Z = SimdT::load(&edge1Z[i]);
+		SimdT e2X = SimdT::load(&edge2X[i]), e2Y = SimdT::load(&edge2Y[i]), e2Z = SimdT::load(&edge2Z[i]);
+
+		//p = direction x edge2
+		SimdT pX = directionY * e2Z - directionZ * e2Y;
+		SimdT pY = directionZ * e2X - directionX * e2Z;
+		SimdT pZ = directionX * e2Y - directionY * e2X;
+		SimdT inverseDeterminant = one / (e1X * pX + e1Y * pY + e1Z * pZ);
+
+		SimdT toOriginX = originX - SimdT::load(&x[i]);
+		SimdT toOriginY = originY - SimdT::load(&y[i]);
+		SimdT toOriginZ = originZ - SimdT::load(&z[i]);
+		SimdT u = (toOriginX * pX + toOriginY * pY + toOriginZ * pZ) * inverseDeterminant;
+
+		//q = toOrigin x edge1
+		SimdT qX = toOriginY * e1Z - toOriginZ * e1Y;
+		SimdT qY = toOriginZ * e1X - toOriginX * e1Z;
+		SimdT qZ = toOriginX * e1Y - toOriginY * e1X;
+		SimdT v = (directionX * qX + directionY * qY + directionZ * qZ) * inverseDeterminant;
+		SimdT hitT = (e2X * qX + e2Y * qY + e2Z * qZ) * inverseDeterminant;
+
+		SimdMask mask = (u >= zero) & (v >= zero) & (u + v <= one) & (hitT >= tMin) & (hitT <= laneBestT);
+		laneBestT = select(mask, hitT, laneBestT);
+		laneBestIndex = select(mask, SimdIndex::lanes(i), laneBestIndex);
+	}
+
+	T lanesT[width];
+	int lanesIndex[width];
+	laneBestT.store(lanesT);
+	laneBestIndex.store(lanesIndex);
+	for (int lane = 0; lane < width; lane++) {
+		if (lanesIndex[lane] >= 0 && lanesT[lane] <= bestT) {
+			bestT = lanesT[lane];
+			bestIndex = lanesIndex[lane];
+		}
+	}
+
+	//whatever didn't fill a full set of lanes
+	for (; i < end; i++) {
+		Vec3<T> edge1(edge1X[i], edge1Y[i], edge1Z[i]);
+		Vec3<T> edge2(edge2X[i], edge2Y[i], edge2Z[i]);
+		Vec3<T> p = ray.direction.cross(edge2);
+		T inverseDeterminant = 1 / edge1.dot(p);
+
+		Vec3<T> toOrigin = ray.origin - Vec3<T>(x[i], y[i], z[i]);
+		T u = toOrigin.dot(p) * inverseDeterminant;
+		Vec3<T> q = toOrigin.cross(edge1);
+		T v = ray.direction.dot(q) * inverseDeterminant;
+		T hitT = edge2.dot(q) * inverseDeterminant;
+
+		if (u >= 0 && v >= 0 && u + v <= 1 && hitT >= ray.tMin && hitT <= bestT) {
+			bestT = hitT;
+			bestIndex = i;
+		}
+	}
+
+	*t = bestT;
+	return bestIndex;
+}
+
+//whether any triangle in [start, start + count) is hit within the ray's range
+template <typename T>
+bool TriangleArray<T>::intersectsAny(const Ray<T>& ray, int start, int count) const {
+	typedef typename Simd<T>::Type SimdT;
+	const int width = Simd<T>::WIDTH;
+
+	int i = start;
+	int end = start + count;
+
+	SimdT originX(ray.origin(0)), originY(ray.origin(1)), originZ(ray.origin(2));
+	SimdT directionX(ray.direction(0)), directionY(ray.direction(1)), directionZ(ray.direction(2));
+	SimdT tMin(ray.tMin), tMax(ray.tMax);
+	SimdT zero((T)0), one((T)1);
+
+	for (; i + width <= end; i += width) {
+		SimdT e1X = SimdT::load(&edge1X[i]), e1Y = SimdT::load(&edge1Y[i]), e1Z = SimdT::load(&edge1Z[i]);
+		SimdT e2X = SimdT::load(&edge2X[i]), e2Y = SimdT::load(&edge2Y[i]), e2Z = SimdT::load(&edge2Z[i]);
+
+		SimdT pX = directionY * e2Z - directionZ * e2Y;
+		SimdT pY = directionZ * e2X - directionX * e2Z;
+		SimdT pZ = directionX * e2Y - directionY * e2X;
+		SimdT inverseDeterminant = one / (e1X * pX + e1Y * pY + e1Z * pZ);
+
+		SimdT toOriginX = originX - SimdT::load(&x[i]);
+		SimdT toOriginY = originY - SimdT::load(&y[i]);
+		SimdT toOriginZ = originZ - SimdT::load(&z[i]);
+		SimdT u = (toOriginX * pX + toOriginY * pY + toOriginZ * pZ) * inverseDeterminant;
+
+		SimdT qX = toOriginY * e1Z - toOriginZ * e1Y;
+		SimdT qY = toOriginZ * e1X - toOriginX * e1Z;
+		SimdT qZ = toOriginX * e1Y - toOriginY * e1X;
+		SimdT v = (directionX * qX + directionY * qY + directionZ * qZ) * inverseDeterminant;
+		SimdT hitT = (e2X * qX + e2Y * qY + e2Z * qZ) * inverseDeterminant;
+
+		if (((u >= zero) & (v >= zero) & (u + v <= one) & (hitT >= tMin) & (hitT <= tMax)).any())
+			return true;
+	}
+
+	for (; i < end; i++) {
+		Vec3<T> edge1(edge1X[i], edge1Y[i], edge1Z[i]);
+		Vec3<T> edge2(edge2X[i], edge2Y[i], edge2Z[i]);
+		Vec3<T> p = ray.direction.cross(edge2);
+		T inverseDeterminant = 1 / edge1.dot(p);
+
+		Vec3<T> toOrigin = ray.origin - Vec3<T>(x[i], y[i], z[i]);
+		T u = toOrigin.dot(p) * inverseDeterminant;
+		Vec3<T> q = toOrigin.cross(edge1);
+		T v = ray.direction.dot(q) * inverseDeterminant;
+		T hitT = edge2.dot(q) * inverseDeterminant;
+
+		if (u >= 0 && v >= 0 && u + v <= 1 && hitT >= ray.tMin && hitT <= ray.tMax)
+			return true;
+	}
+
+	return false;
+}
+
+//tests every ray in the packet against triangles [start, start + count), one triangle at a time across the rays
+//shrinks each ray's tMax and records which triangle it hit
+template <typename T>
+void TriangleArray<T>::intersectPacket(RayPacket<T>* packet, int start, int count, int* hitTriangles) const {
+	typedef typename Simd<T>::Type SimdT;
+	typedef typename Simd<T>::Mask SimdMask;
+	typedef typename Simd<T>::Index SimdIndex;
+	const int width = Simd<T>::WIDTH;
+
+	SimdT zero((T)0), one((T)1);
+
+	for (int triangle = start; triangle < start + count; triangle++) {
+		SimdT vertexX(x[triangle]), vertexY(y[triangle]), vertexZ(z[triangle]);
+		SimdT e1X(edge1X[triangle]), e1Y(edge1Y[triangle]), e1Z(edge1Z[triangle]);
+		SimdT e2X(edge2X[triangle]), e2Y(edge2Y[triangle]), e2Z(edge2Z[triangle]);
+		SimdIndex triangleIndex(triangle);
+
+		for (int i = 0; i < PACKET_SIZE; i += width) {
+			SimdT directionX = SimdT::load(&packet->directionX[i]);
+			SimdT directionY = SimdT::load(&packet->directionY[i]);
+			SimdT directionZ = SimdT::load(&packet->directionZ[i]);
+			SimdT tMax = SimdT::load(&packet->tMax[i]);
+
+			SimdT pX = directionY * e2Z - directionZ * e2Y;
+			SimdT pY = directionZ * e2X - directionX * e2Z;
+			SimdT pZ = directionX * e2Y - directionY * e2X;
+			SimdT inverseDeterminant = one / (e1X * pX + e1Y * pY + e1Z * pZ);
+
+			SimdT toOriginX = SimdT::load(&packet->originX[i]) - vertexX;
+			SimdT toOriginY = SimdT::load(&packet->originY[i]) - vertexY;
+			SimdT toOriginZ = SimdT::load(&packet->originZ[i]) - vertexZ;
+			SimdT u = (toOriginX * pX + toOriginY * pY + toOriginZ * pZ) * inverseDeterminant;
+
+			SimdT qX = toOriginY * e1Z - toOriginZ * e1Y;
+			SimdT qY = toOriginZ * e1X - toOriginX * e1Z;
+			SimdT qZ = toOriginX * e1Y - toOriginY * e1X;
+			SimdT v = (directionX * qX + directionY * qY + directionZ * qZ) * inverseDeterminant;
+			SimdT hitT = (e2X * qX + e2Y * qY + e2Z * qZ) * inverseDeterminant;
+
+			SimdMask mask = (u >= zero) & (v >= zero) & (u + v <= one) & (hitT >= SimdT::load(&packet->tMin[i])) & (hitT <= tMax);
+			if (!mask.any())
+				continue;
+
+			select(mask, hitT, tMax).store(&packet->tMax[i]);
+			select(mask, triangleIndex, SimdIndex::load(&hitTriangles[i])).store(&hitTriangles[i]);
+		}
+	}
+}
+
+template class RayTracer::TriangleArray<float>;
+template class RayTracer::TriangleArray<double>;
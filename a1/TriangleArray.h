@@ -0,0 +1,38 @@
+#ifndef TRIANGLEARRAY_H
+#define TRIANGLEARRAY_H
+
+#include <Eigen\Dense>
+#include "Ray.h"
+#include "RayPacket.h"
+#include "AlignedAllocator.h"
+
+using namespace Eigen;
+
+namespace RayTracer {
+	//one mesh's triangles as structure-of-arrays, each stored as a vertex and the two edges leaving it
+	//(what Moller-Trumbore works with, so nothing is recomputed per ray)
+	//this is only geometry, shared by every instance of the mesh, which give it a material and a place in the scene
+	template <typename T>
+	class TriangleArray {
+	public:
+		TriangleArray();
+		void add(const Vec3<T>& v0, const Vec3<T>& v1, const Vec3<T>& v2);
+		int size() const;
+		Vec3<T> normal(int triangle) const;
+		int intersect(const Ray<T>& ray, int start, int count, T* t) const;
+		bool intersectsAny(const Ray<T>& ray, int start, int count) const;
+		void intersectPacket(RayPacket<T>* packet, int start, int count, int* hitTriangles) const;
+
+		AlignedArray<T> x;
+		AlignedArray<T> y;
+		AlignedArray<T> z;
+		AlignedArray<T> edge1X;
+		AlignedArray<T> edge1Y;
+		AlignedArray<T> edge1Z;
+		AlignedArray<T> edge2X;
+		AlignedArray<T> edge2Y;
+		AlignedArray<T> edge2Z;
+	};
+}
+
+#endif
@@ -0,0 +1,306 @@
+#include "Wavefront.h"
+#include <algorithm>
+#include "RayPacket.h"
+#include "Renderer.h"
+
+using namespace RayTracer;
+using namespace Eigen;
+using namespace std;
+
+//reflections are binned by origin into BIN_CELLS x BIN_CELLS x BIN_CELLS cells within each octant
+//(at most 8, the cells' Morton codes only have 3 bits an axis)
+#define BIN_CELLS 8
+
+/*========
+ * QUEUES
+ *========*/
+template <typename T>
+void RayQueue<T>::clear() {
+	originX.clear();
+	originY.clear();
+	originZ.clear();
+	directionX.clear();
+	directionY.clear();
+	directionZ.clear();
+	tMin.clear();
+	primary.clear();
+	throughputR.clear();
+	throughputG.clear();
+	throughputB.clear();
+}
+
+template <typename T>
+int RayQueue<T>::size() const {
+	return primary.size();
+}
+
+template <typename T>
+void RayQueue<T>::push(const Ray<T>& ray, int primary, const Vec3<T>& throughput) {
+	originX.push_back(ray.origin(0));
+	originY.push_back(ray.origin(1));
+	originZ.push_back(ray.origin(2));
+	directionX.push_back(ray.direction(0));
+	directionY.push_back(ray.direction(1));
+	directionZ.push_back(ray.direction(2));
+	tMin.push_back(ray.tMin);
+	this->primary.push_back(primary);
+	throughputR.push_back(throughput(0));
+	throughputG.push_back(throughput(1));
+	throughputB.push_back(throughput(2));
+}
+
+template <typename T>
+Ray<T> RayQueue<T>::getRay(int i) const {
+	return Ray<T>(Vec3<T>(originX[i], originY[i], originZ[i]), Vec3<T>(directionX[i], directionY[i], directionZ[i]), tMin[i]);
+}
+
+template <typename T>
+void ShadowQueue<T>::clear() {
+	originX.clear();
+	originY.clear();
+	originZ.clear();
+	directionX.clear();
+	directionY.clear();
+	directionZ.clear();
+	tMax.clear();
+	hit.clear();
+	lightR.clear();
+	lightG.clear();
+	lightB.clear();
+	lightIndex.clear();
+}
+
+template <typename T>
+int ShadowQueue<T>::size() const {
+	return hit.size();
+}
+
+template <typename T>
+void ShadowQueue<T>::push(const Vec3<T>& origin, const Vec3<T>& direction, T tMax, int hit, const Vec3<T>& light, int lightIndex) {
+	originX.push_back(origin(0));
+	originY.push_back(origin(1));
+	originZ.push_back(origin(2));
+	directionX.push_back(direction(0));
+	directionY.push_back(direction(1));
+	directionZ.push_back(direction(2));
+	this->tMax.push_back(tMax);
+	this->hit.push_back(hit);
+	lightR.push_back(light(0));
+	lightG.push_back(light(1));
+	lightB.push_back(light(2));
+	this->lightIndex.push_back(lightIndex);
+}
+
+/*===========
+ * WAVEFRONT
+ *===========*/
+template <typename T>
+Wavefront<T>::Wavefront(const Scene<T>* scene, bool binning) {
+	this->scene = scene;
+	this->binning = binning;
+}
+
+//traces every ray in primaries (as if by traceRay with depth), writing the colour of primary i to colours[indices[i]]
+//and what it hit to objects[indices[i]]
+//with packets, the primaries are found PACKET_SIZE at a time, so they should be queued in blocks of neighbouring rays
+template <typename T>
+void Wavefront<T>::trace(bool packets, int depth, ShadowCache<T>* shadowCache, Vector3d* colours, int* objects) {
+	int count = primaries.size();
+	int i;
+
+	colourR.assign(count, 0);
+	colourG.assign(count, 0);
+	colourB.assign(count, 0);
+
+	//the primaries are shaded whatever the depth, like traceSamples does, it only limits the reflections
+	const RayQueue<T>* queue = &primaries;
+	for (int bounce = 0; queue->size() > 0; bounce++) {
+		findHits(*queue, packets && bounce == 0);
+		if (bounce == 0) {
+			for (i = 0; i < count; i++)
+				objects[indices[i]] = -1;
+			for (i = 0; i < (int)hits.size(); i++)
+				objects[indices[hitRays[i]]] = hits[i].objectIndex;
+		}
+
+		queueShadows();
+		testShadows(shadowCache);
+
+		RayQueue<T>* next = &bounces[bounce % 2];
+		shade(*queue, depth - bounce, next);
+		if (binning)
+			binRays(next);
+		queue = next;
+	}
+
+	for (i = 0; i < count; i++)
+		colours[indices[i]] = Vector3d(colourR[i], colourG[i], colourB[i]);
+}
+
+//nearest hit of every ray in queue, leaving only the rays which hit something in hits (and which ray each was in hitRays)
+template <typename T>
+void Wavefront<T>::findHits(const RayQueue<T>& queue, bool packets) {
+	int count = queue.size();
+	int i;
+
+	hits.assign(count, Intersection<T>());
+	if (packets) {
+		for (int first = 0; first < count; first += PACKET_SIZE) {
+			RayPacket<T> packet;
+			for (i = 0; i < PACKET_SIZE && first + i < count; i++)
+				packet.setRay(i, queue.getRay(first + i));
+			scene->closestIntersections(&packet, &hits[first]);
+		}
+	}
+	else {
+		for (i = 0; i < count; i++) {
+			Ray<T> ray = queue.getRay(i);
+			scene->closestIntersection(&ray, &hits[i]);
+		}
+	}
+
+	//misses only add the background, which is black
+	hitRays.clear();
+	for (i = 0; i < count; i++) {
+		if (hits[i].objectIndex >= 0) {
+			hits[hitRays.size()] = hits[i];
+			hitRays.push_back(i);
+		}
+	}
+	hits.resize(hitRays.size());
+}
+
+//starts each hit's light at the ambient, and queues a shadow ray to every light it faces and is in reach of (or every one picked for it)
+template <typename T>
+void Wavefront<T>::queueShadows() {
+	const T ambientLight = 25;
+	int count = hits.size();
+
+	lightR.assign(count, ambientLight);
+	lightG.assign(count, ambientLight);
+	lightB.assign(count, ambientLight);
+
+	shadows.clear();
+	for (int i = 0; i < count; i++) {
+		const Intersection<T>& hit = hits[i];
+		int cluster = scene->lightCluster(hit.point);
+		int shadowRays = scene->shadowRays(cluster);
+		for (int shadowRay = 0; shadowRay < shadowRays; shadowRay++) {
+			T weight;
+			int lightNum = scene->shadowRayLight(hit.point, hit.normal, cluster, shadowRay, &weight);
+			if (lightNum < 0)
+				continue;
+
+			const Light<T>& light = scene->lights[lightNum];
+			Vec3<T> toLight = light.position - hit.point;
+			Vec3<T> toLightNormalized = toLight.normalized();
+			T dot = toLightNormalized.dot(hit.normal);
+			T falloff = light.falloff(toLight.squaredNorm());
+
+			if (dot > 0 && falloff > 0)
+				shadows.push(hit.point, toLightNormalized, toLight.norm(), i, light.colour * (dot * weight * falloff), lightNum);
+		}
+	}
+}
+
+//adds the light of every shadow ray which gets through to its hit
+//(they're queued in light order for each hit, so each hit's light is added up in the same order as traceRay does it)
+//each light has its own occluder in the shadow cache, so it doesn't matter that the rays to different lights are mixed together
+template <typename T>
+void Wavefront<T>::testShadows(ShadowCache<T>* shadowCache) {
+	int count = shadows.size();
+	for (int i = 0; i < count; i++) {
+		Vec3<T> origin(shadows.originX[i], shadows.originY[i], shadows.originZ[i]);
+		Vec3<T> direction(shadows.directionX[i], shadows.directionY[i], shadows.directionZ[i]);
+		if (scene->occluded(origin, direction, shadows.tMax[i], shadows.lightIndex[i], shadowCache))
+			continue;
+
+		int hit = shadows.hit[i];
+		lightR[hit] += shadows.lightR[i];
+		lightG[hit] += shadows.lightG[i];
+		lightB[hit] += shadows.lightB[i];
+	}
+}
+
+//adds each hit's own colour (less what it reflects) to its primary, and queues its reflection in next
+//if there are any bounces left after this one (remainingDepth counts this one)
+template <typename T>
+void Wavefront<T>::shade(const RayQueue<T>& queue, int remainingDepth, RayQueue<T>* next) {
+	int count = hits.size();
+
+	next->clear();
+	for (int i = 0; i < count; i++) {
+		const Intersection<T>& hit = hits[i];
+		const Material<T>& material = scene->materials[hit.material];
+		int ray = hitRays[i];
+		int primary = queue.primary[ray];
+		T reflectivity = material.reflectivity;
+
+		T scaleR = lightR[i] / 255;
+		T scaleG = lightG[i] / 255;
+		T scaleB = lightB[i] / 255;
+		T surface = reflectivity > 0 ? 1 - reflectivity : 1;
+		colourR[primary] += queue.throughputR[ray] * (material.colour(0) * surface * scaleR);
+		colourG[primary] += queue.throughputG[ray] * (material.colour(1) * surface * scaleG);
+		colourB[primary] += queue.throughputB[ray] * (material.colour(2) * surface * scaleB);
+
+		if (reflectivity > 0 && remainingDepth - 1 > 0) {
+			Vec3<T> direction(queue.directionX[ray], queue.directionY[ray], queue.directionZ[ray]);
+			Vec3<T> reflectedDirection = direction - ((2 * (hit.normal.dot(direction))) * hit.normal);
+			Ray<T> reflectedRay(hit.point, reflectedDirection, Ray<T>::epsilon);
+
+			//rouletted the same way as traceRay's reflections, so faint ones mostly don't make it into the next bounce
+			Vec3<T> throughput = Vec3<T>(queue.throughputR[ray], queue.throughputG[ray], queue.throughputB[ray]).cwiseProduct(
+				Vec3<T>(lightR[i], lightG[i], lightB[i])) * (reflectivity / 255);
+			T weight;
+			if (continuePath(reflectedRay, throughput.maxCoeff(), &weight))
+				next->push(reflectedRay, primary, throughput * weight);
+		}
+	}
+}
+
+//spreads the low 3 bits of v out to every third bit, for a Morton code
+static unsigned int spreadBits(unsigned int v) {
+	return (v & 1) | ((v & 2) << 2) | ((v & 4) << 4);
+}
+
+//sorts queue by octant, then by the Morton code of the cell its origin is in
+//every primary has at most one ray in a bounce, so the order they're traced in doesn't change what's added to it
+template <typename T>
+void Wavefront<T>::binRays(RayQueue<T>* queue) {
+	int count = queue->size();
+	int i;
+	if (count < 2)
+		return;
+
+	Box3<T> bounds;
+	for (i = 0; i < count; i++)
+		bounds.extend(Vec3<T>(queue->originX[i], queue->originY[i], queue->originZ[i]));
+	Vec3<T> cellScale = Vec3<T>::Constant((T)BIN_CELLS).cwiseQuotient(bounds.sizes().cwiseMax(Vec3<T>::Constant(Ray<T>::epsilon)));
+
+	binKeys.resize(count);
+	for (i = 0; i < count; i++) {
+		unsigned int octant = (queue->directionX[i] < 0 ? 1 : 0) | (queue->directionY[i] < 0 ? 2 : 0) | (queue->directionZ[i] < 0 ? 4 : 0);
+		Vec3<T> cell = (Vec3<T>(queue->originX[i], queue->originY[i], queue->originZ[i]) - bounds.min()).cwiseProduct(cellScale);
+		unsigned int cellX = min((unsigned int)cell(0), (unsigned int)BIN_CELLS - 1);
+		unsigned int cellY = min((unsigned int)cell(1), (unsigned int)BIN_CELLS - 1);
+		unsigned int cellZ = min((unsigned int)cell(2), (unsigned int)BIN_CELLS - 1);
+		unsigned int bin = (octant << 9) | (spreadBits(cellX) << 2) | (spreadBits(cellY) << 1) | spreadBits(cellZ);
+		binKeys[i] = ((unsigned long long)bin << 32) | (unsigned int)i;
+	}
+	sort(binKeys.begin(), binKeys.end());
+
+	binned.clear();
+	for (i = 0; i < count; i++) {
+		int ray = (int)(binKeys[i] & 0xFFFFFFFF);
+		binned.push(queue->getRay(ray), queue->primary[ray], Vec3<T>(queue->throughputR[ray], queue->throughputG[ray], queue->throughputB[ray]));
+	}
+	swap(*queue, binned);
+}
+
+template class RayTracer::RayQueue<float>;
+template class RayTracer::RayQueue<double>;
+template class RayTracer::ShadowQueue<float>;
+template class RayTracer::ShadowQueue<double>;
+template class RayTracer::Wavefront<float>;
+template class RayTracer::Wavefront<double>;
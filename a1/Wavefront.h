@@ -0,0 +1,104 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include <Eigen\Dense>
+#include <vector>
+#include "Ray.h"
+#include "Scene.h"
+#include "AlignedAllocator.h"
+
+using namespace Eigen;
+
+namespace RayTracer {
+	//rays waiting to be traced by a wavefront, as structure-of-arrays
+	//each one is for primary (its position in the first queue), and throughput is how much of its colour reaches that
+	template <typename T>
+	class RayQueue {
+	public:
+		void clear();
+		int size() const;
+		void push(const Ray<T>& ray, int primary, const Vec3<T>& throughput);
+		Ray<T> getRay(int i) const;
+
+		AlignedArray<T> originX;
+		AlignedArray<T> originY;
+		AlignedArray<T> originZ;
+		AlignedArray<T> directionX;
+		AlignedArray<T> directionY;
+		AlignedArray<T> directionZ;
+		AlignedArray<T> tMin;
+		AlignedArray<int> primary;
+		AlignedArray<T> throughputR;
+		AlignedArray<T> throughputG;
+		AlignedArray<T> throughputB;
+	};
+
+	//shadow rays from the hits of one bounce, to be tested all together
+	//hit is the position of the hit it's from, light is the light it brings (already scaled by the angle) if nothing's in the way
+	//and lightIndex is which light that is
+	template <typename T>
+	class ShadowQueue {
+	public:
+		void clear();
+		int size() const;
+		void push(const Vec3<T>& origin, const Vec3<T>& direction, T tMax, int hit, const Vec3<T>& light, int lightIndex);
+
+		AlignedArray<T> originX;
+		AlignedArray<T> originY;
+		AlignedArray<T> originZ;
+		AlignedArray<T> directionX;
+		AlignedArray<T> directionY;
+		AlignedArray<T> directionZ;
+		AlignedArray<T> tMax;
+		AlignedArray<int> hit;
+		AlignedArray<T> lightR;
+		AlignedArray<T> lightG;
+		AlignedArray<T> lightB;
+		AlignedArray<int> lightIndex;
+	};
+
+	//traces a batch of rays a stage at a time instead of a ray at a time (the way traceRay recurses):
+	//find every ray's nearest hit, shade the hits and queue their shadow rays, test all of those,
+	//then add up the light and queue the reflections as the next bounce, until there are none left
+	//each stage is a flat loop over a queue with the misses and finished rays taken out, so nothing waits on a deeper bounce
+	//reflections are added up front to back with their throughput instead of back to front, so colours
+	//can differ from traceRay's in the last bits
+	//the queues are kept between calls, so one Wavefront should be reused for many batches (one per thread)
+	//a batch is traced by filling in primaries and indices, then calling trace (with the thread's ShadowCache, or NULL)
+	//with binning, each bounce's reflections are sorted by which way they go (their octant) and then where they
+	//start (a cell of the bounds of their origins) before they're traced, so rays following each other go through
+	//the same BVH nodes and primitives; the image is the same either way
+	template <typename T>
+	class Wavefront {
+	public:
+		Wavefront(const Scene<T>* scene, bool binning = false);
+		void trace(bool packets, int depth, ShadowCache<T>* shadowCache, Vector3d* colours, int* objects);
+
+		const Scene<T>* scene;
+		bool binning;
+		RayQueue<T> primaries; //each one's primary is its own position, with a throughput of 1
+		std::vector<int> indices; //where each primary's colour goes
+
+	private:
+		void findHits(const RayQueue<T>& queue, bool packets);
+		void queueShadows();
+		void testShadows(ShadowCache<T>* shadowCache);
+		void shade(const RayQueue<T>& queue, int remainingDepth, RayQueue<T>* next);
+		void binRays(RayQueue<T>* queue);
+
+		std::vector<Intersection<T> > hits;
+		std::vector<int> hitRays; //which ray of the queue each compacted hit is from
+		AlignedArray<T> lightR; //light reaching each hit, ambient included
+		AlignedArray<T> lightG;
+		AlignedArray<T> lightB;
+		ShadowQueue<T> shadows;
+		RayQueue<T> bounces[2];
+		RayQueue<T> binned;
+		std::vector<unsigned long long> binKeys; //bin in the high half, ray in the low half
+		AlignedArray<T> colourR; //per primary
+		AlignedArray<T> colourG;
+		AlignedArray<T> colourB;
+	};
+}
+
+#endif
@@ -1,139 +1,25 @@
 #include "Image.h"
 #include <Eigen\Dense>
 #include <vector>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
 
 #include "main.h"
 #include "Ray.h"
 #include "SceneObject.h"
+#include "Scene.h"
+#include "Renderer.h"
+#include "Benchmark.h"
+#include "MeshLoader.h"
+#include "Preview.h"
 
 using namespace Eigen;
 using namespace std;
 using namespace RayTracer;
 
-namespace RayTracer {
-	vector<Intersection*>* getIntersections(vector<SceneObject*>* objects, Ray* ray, SceneObject* ignore, bool any) {
-		unsigned int i;
-		SceneObject* obj;
-
-		vector<Intersection*>* v = new vector<Intersection*>();
-
-		for (i = 0; i < objects->size(); i++) {
-			obj = (*objects)[i];
-			if (obj == ignore)
-				continue;
-			Intersection* intersect = obj->rayIntersect(ray);
-			if (intersect != NULL) {
-				v->push_back(intersect);
-				if (any)
-					break;
-			}
-		}
-
-		return v;
-	}
-
-	Intersection* getClosestIntersection(Vector3d* point, vector<Intersection*>* intersections) {
-		if (intersections->size() == 0)
-			return NULL;
-
-		double smallestDistance = DBL_MAX;
-		Intersection* closest = NULL;
-		Intersection* intersection = NULL;
-		unsigned int i = 0;
-
-		for (i = 0; i < intersections->size(); i++) {
-			intersection = (*intersections)[i];
-			double distance = (*(intersection->origin) - *point).norm();
-			if (distance < smallestDistance) {
-				smallestDistance = distance;
-				closest = intersection;
-			}
-		}
-
-		return closest;
-	}
-
-	Vector3d traceRay(Ray* ray, vector<SceneObject*>* objects, vector<SceneObject*>* lights, int remainingDepth) {
-		Vector3d backgroundColour(0, 0, 0);
-		Vector3d ambientLight(25, 25, 25);
-
-		/*Vector3d RED(255, 0, 0);
-		Vector3d GREEN(0, 255, 0);
-		Vector3d BLUE(255, 0, 255);
-		Vector3d YELLOW(255, 255, 0);
-		Vector3d CYAN(0, 255, 255);
-		Vector3d MAJENTA(255, 0, 255);*/
-
-		if (remainingDepth <= 0)
-			return backgroundColour;
-
-		vector<Intersection*>* intersections = getIntersections(objects, ray, NULL, false);
-		Intersection* closestIntersection = getClosestIntersection(ray->origin, intersections);
-		intersections->clear();
-		delete intersections;
-
-		if (closestIntersection != NULL) {
-			Vector3d fullLightColour = ambientLight;
-			Vector3d surfaceColour = *(closestIntersection->object->colour);
-
-			//for each light, add it to the full light on this point (if not blocked)
-			for (unsigned int lightNum = 0; lightNum < lights->size(); lightNum++) {
-				SceneObject* light = (*lights)[lightNum];
-				Vector3d toLight = *(light->position) - *(closestIntersection->origin);
-				Vector3d toLightNormalized = toLight.normalized();
-				double dot = toLightNormalized.dot(*(closestIntersection->direction));
-
-				if (dot > 0) {
-					intersections = getIntersections(objects, new Ray(closestIntersection->origin, &toLightNormalized), closestIntersection->object, true);
-					bool inLight = false;
-					if (intersections->size() == 0) {
-						inLight = true;
-					}
-					else {
-						Intersection* intersection = (*intersections)[0];
-						SceneObject* obj = intersection->object;
-						intersections->clear();
-
-						if ((*(intersection->origin) - *(closestIntersection->origin)).norm() > toLight.norm()) {
-							inLight = true;
-						}
-					}
-
-					if (inLight) {
-						fullLightColour += *(light->colour) * dot;
-					}
-
-					delete intersections;
-				}
-			}
-
-			double reflectivity = closestIntersection->object->reflectivity;
-			if (reflectivity > 0) {
-				Vector3d rayDirection = *(ray->direction);
-				Vector3d normal = *(closestIntersection->direction);
-				Vector3d reflectedDirection = rayDirection - ((2 * (normal.dot(rayDirection))) * normal);
-				Ray* reflectedRay = new Ray(closestIntersection->origin, &reflectedDirection);
-
-				Vector3d reflectionColour = traceRay(reflectedRay, objects, lights, remainingDepth - 1);
-				delete reflectedRay;
-
-				surfaceColour *= 1 - reflectivity;
-				surfaceColour += reflectionColour * reflectivity;
-			}
-
-			Vector3d endColour = surfaceColour;
-			endColour[0] *= fullLightColour[0] / 255;
-			endColour[1] *= fullLightColour[1] / 255;
-			endColour[2] *= fullLightColour[2] / 255;
-
-			return endColour;
-		}
-		else {
-			return backgroundColour;
-		}
-	}
-}
-
 void printVector(Vector3d* v, int numSpaces, bool newLine) {
 	for (int i = 0; i < numSpaces; i++)
 		printf(" ");
@@ -173,25 +59,41 @@ Vector3d* vectorFromPixel(Pixel* px) {
 	return new Vector3d(px->R, px->G, px->B);
 }
 
-int main(int, char**) {
+//writes each tile straight into the image as it's traced, so there's never a full size copy of it in colours
+//(tiles don't overlap, so threads never write the same pixel)
+//and passes it on to the preview, if there is one
+class ImageSink : public TileSink {
+public:
+	ImageSink(Image* image, TileSink* preview) {
+		this->image = image;
+		this->preview = preview;
+	}
+
+	void writeTile(unsigned int x0, unsigned int y0, unsigned int width, unsigned int height, const Vector3d* colours) {
+		unsigned int imageHeight = image->height();
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++)
+				(*image)(x0 + x, imageHeight - (y0 + y) - 1) = getPixel(colours[y * width + x]);
+		}
+
+		if (preview != NULL)
+			preview->writeTile(x0, y0, width, height, colours);
+	}
+
+	Image* image;
+	TileSink* preview;
+};
+
+int main(int argc, char** argv) {
 	unsigned int imageWidth = 600;
 	unsigned int imageHeight = 600;
 
-	unsigned int width = 0;
-	unsigned int height = 0;
-	unsigned int x, y;
+	int depth = 2;
 
+	//samples per pixel along each side, any number
+	//with adaptive, only pixels on edges (where the colour or the object changes) get more than one
 	unsigned int supersampling = 2;
-	if (supersampling % 2 == 1)
-		supersampling = 1;
-
-	width = imageWidth * supersampling;
-	height = imageHeight * supersampling;
-
-	Vector3d** pixelColours = new Vector3d*[width];
-	for (unsigned int i = 0; i < width; i++) {
-		pixelColours[i] = new Vector3d[height];
-	}
+	bool adaptive = true;
 
 	Image image(imageWidth, imageHeight);
 
@@ -225,51 +127,219 @@ int main(int, char**) {
 	objects->push_back(plane1);
 	objects->push_back(plane2);
 
+	//a field of small spheres floating in front of everything else, for testing the sphere accelerators
+	unsigned int particles = 0;
+	srand(305);
+	for (unsigned int i = 0; i < particles; i++) {
+		Vector3d* position = new Vector3d(rand() % 1000 - 200, rand() % 800, rand() % 600 - 300);
+		double radius = 1 + (rand() % 100) / 50.0;
+		objects->push_back(new Sphere(position, radius, new Vector3d(255, 255, 150 + rand() % 100)));
+	}
+
+	//a mesh to put in the scene can be given on the command line (OBJ or PLY)
+	//optionally followed by a number of copies, which are laid out in a grid on the floor as instances of it
+	if (argc > 1) {
+		Mesh* mesh = loadMesh(argv[1], new Vector3d(200, 200, 255));
+		int copies = argc > 2 ? atoi(argv[2]) : 1;
+		if (mesh != NULL) {
+			printf("loaded %s: %d vertices, %d triangles\n", argv[1], (int)mesh->vertices.size(), mesh->triangleCount());
+			if (copies <= 1) {
+				mesh->fit(Vector3d(420, 250, 150), 250);
+				objects->push_back(mesh);
+			}
+			else {
+				int gridSize = (int)ceil(sqrt((double)copies));
+				double cellSize = 1200.0 / gridSize;
+				mesh->fit(Vector3d(0, 0, 0), 1);
+
+				for (int copy = 0; copy < copies; copy++) {
+					Vector3d cellCentre(-300 + (copy % gridSize + 0.5) * cellSize, cellSize * 0.4, (copy / gridSize + 0.5) * cellSize);
+					Affine3d transform = Translation3d(cellCentre) * AngleAxisd(copy * 0.7, Vector3d::UnitY()) * Scaling(cellSize * 0.8);
+					Vector3d* colour = new Vector3d(100 + (copy * 37) % 156, 100 + (copy * 71) % 156, 100 + (copy * 113) % 156);
+					objects->push_back(new Instance(mesh, transform, colour));
+				}
+				printf("%d instances, %.0f triangles in the scene\n", copies, (double)copies * mesh->triangleCount());
+			}
+		}
+	}
+
 	SceneObject* light1 = new SceneObject(new Vector3d(-300, 300, 0), new Vector3d(250, 100, 100));
 	SceneObject* light2 = new SceneObject(new Vector3d(800, 500, -1000), new Vector3d(100, 100, 250));
 	lights->push_back(light1);
 	lights->push_back(light2);
 
-	Vector3d cameraTopLeft = cameraPosition;
-	cameraTopLeft(0) = 0;//-= width / 2;
-	cameraTopLeft(1) = 0;//-= height / 2;
+	//a cloud of small lights over the scene, for testing many-light sampling (together about as bright as one of the others)
+	//with a radius, each one only lights what's near it, for testing light culling (turn smallLightBrightness up to see them)
+	unsigned int smallLights = 0;
+	double smallLightRadius = 0;
+	double smallLightBrightness = 300;
+	for (unsigned int i = 0; i < smallLights; i++) {
+		Vector3d* position = new Vector3d(rand() % 1400 - 400, rand() % 1000, rand() % 1600 - 1000);
+		double brightness = smallLightBrightness / smallLights;
+		SceneObject* light = new SceneObject(position, new Vector3d(brightness * (rand() % 100) / 50, brightness * (rand() % 100) / 50, brightness));
+		light->lightRadius = smallLightRadius;
+		lights->push_back(light);
+	}
 
-	bool abortLoop = false;
+	//check that the accelerators find the same nearest hits as testing every object and that big primitive indices
+	//survive the SIMD kernels, instead of making the image (exits with 1 if anything differs)
+	bool checkAccelerators = false;
+	if (checkAccelerators)
+		return checkPrimitiveIndices() && checkDeepBVH(1000) && checkIntersections(objects, 5000, 100000) ? 0 : 1;
+
+	//trace the scene in float and in double and compare them, instead of making the image
+	bool benchmark = false;
+	if (benchmark) {
+		benchmarkPrecision(objects, lights, cameraPosition, imageWidth, imageHeight, supersampling, depth);
+		return 0;
+	}
 
-	for (x = 0; x < width && !abortLoop; x++) {
-		printf("line %d\n", x);
-		for (y = 0; y < height && !abortLoop; y++) {
-			bool testOverride = false;
+	//compare the SAH and Morton BVH builders over the spheres (turn the particles up for this), instead of making the image
+	bool benchmarkBuild = false;
+	if (benchmarkBuild) {
+		benchmarkBuilds(objects, lights, cameraPosition, imageWidth, imageHeight, supersampling, depth);
+		return 0;
+	}
 
-			//cast a ray!
-			Vector3d rayOrigin;
-			rayOrigin = Vector3d(x / (double)supersampling, y / (double)supersampling, 0);
+	//compare adaptive supersampling against tracing every sample, instead of making the image
+	bool benchmarkSupersampling = false;
+	if (benchmarkSupersampling) {
+		benchmarkAdaptive(objects, lights, cameraPosition, imageWidth, imageHeight, supersampling, depth);
+		return 0;
+	}
 
-			Vector3d rayDirection = (rayOrigin - cameraPosition).normalized();
-			Ray ray(&rayOrigin, &rayDirection);
+	//compare tracing a ray at a time against tracing wavefronts, at this depth and deeper, instead of making the image
+	bool benchmarkTracing = false;
+	if (benchmarkTracing) {
+		benchmarkWavefront(objects, lights, cameraPosition, imageWidth, imageHeight, supersampling, depth);
+		return 0;
+	}
 
-			pixelColours[x][y] = traceRay(&ray, objects, lights, 2);
-		}
+	//compare shading every sample against shading once per thing hit in each pixel, instead of making the image
+	bool benchmarkShading = false;
+	if (benchmarkShading) {
+		benchmarkDecoupled(objects, lights, cameraPosition, imageWidth, imageHeight, supersampling, depth);
+		return 0;
 	}
 
-	for (x = 0; x < imageWidth; x++) {
-		for (y = 0; y < imageHeight; y++) {
-			if (supersampling > 1) {
-				Vector3d colour(0, 0, 0);
-				unsigned int x2, y2;
-				for (x2 = 0; x2 < supersampling; x2++) {
-					for (y2 = 0; y2 < supersampling; y2++) {
-						colour += pixelColours[x*2 + x2][y*2 + y2];
-					}
-				}
-				colour /= (supersampling * supersampling);
+	//compare tracing wavefronts with and without sorting the reflections, with sphere1 as it is and with every sphere a mirror
+	//(turn the particles up for this), instead of making the image
+	bool benchmarkReflections = false;
+	if (benchmarkReflections) {
+		benchmarkBinning(objects, lights, cameraPosition, imageWidth, imageHeight, supersampling, depth);
+		return 0;
+	}
 
-				image(x, imageHeight - y - 1) = getPixel(colour);
-			}
-			else {
-				image(x, imageHeight - y - 1) = getPixel(pixelColours[x][y]);
-			}
+	//compare lighting from every light against sampling a few of them, instead of making the image (turn the small lights up for this)
+	bool benchmarkLights = false;
+	if (benchmarkLights) {
+		benchmarkLightSampling(objects, lights, cameraPosition, imageWidth, imageHeight, supersampling, depth);
+		return 0;
+	}
+
+	//compare searching for every shadow ray's occluder against trying the last one found for that light first, instead of making the image
+	bool benchmarkShadows = false;
+	if (benchmarkShadows) {
+		benchmarkShadowCache(objects, lights, cameraPosition, imageWidth, imageHeight, supersampling, depth);
+		return 0;
+	}
+
+	//compare lighting from every light against only the ones which could reach each point, instead of making the image
+	//(turn the small lights up and give them a radius for this)
+	bool benchmarkCulling = false;
+	if (benchmarkCulling) {
+		benchmarkLightCulling(objects, lights, cameraPosition, imageWidth, imageHeight, supersampling, depth);
+		return 0;
+	}
+
+	//SPHERE_GRID builds faster and suits lots of similar sized spheres (like the particles), SPHERE_BVH suits anything
+	//SPHERE_LBVH is the one to use if the spheres move and have to be rebuilt every frame (with Scene::updateSpheres)
+	SphereAccelerator sphereAccelerator = SPHERE_BVH;
+
+	Scene<Scalar>* scene = new Scene<Scalar>(objects, lights, sphereAccelerator);
+
+	//shadow rays per shading point, to lights picked by how much they're likely to light it (0 for one to every light)
+	//for scenes with lots of lights, the image is right on average and gets closer with more samples per pixel
+	scene->lightSamples = 0;
+
+	Vector3d cameraTopLeft = cameraPosition;
+	cameraTopLeft(0) = 0;//-= width / 2;
+	cameraTopLeft(1) = 0;//-= height / 2;
+
+	//TRACE_PACKETS traces primary rays in PACKET_WIDTH x PACKET_WIDTH blocks (reflections are still traced one at a time)
+	//TRACE_WAVEFRONT traces each bounce of a tile's rays together, a stage at a time, which suits deep reflections
+	//TRACE_BINNED_WAVEFRONT sorts each bounce's reflections by where they go first, which helps in scenes full of mirrors
+	//TRACE_DECOUPLED shades each thing a pixel's samples hit once, instead of every sample (only edges get antialiased)
+	TraceMode traceMode = TRACE_PACKETS;
+
+	//how many threads to trace on, 0 for one per core (the image is the same either way)
+	int threads = 0;
+
+	//show the image while it's traced, in a window or (without a display) by saving it every few seconds
+	bool previewWindow = false;
+	bool previewSnapshots = false;
+
+	PreviewSink* preview = NULL;
+	if (previewWindow)
+		preview = new WindowPreview(imageWidth, imageHeight, "Ray Tracer (tracing)");
+	else if (previewSnapshots)
+		preview = new SnapshotPreview(imageWidth, imageHeight, "preview.ppm", 2);
+
+	//trace a rough version of the whole image first and refine it, rather than finishing it a tile at a time (best with a preview)
+	bool progressive = false;
+
+	//stop refining after this many seconds (0 for no limit), keeping the best whole image traced by then
+	//it's traced progressively with a limit whatever progressive is, as that's what leaves a whole image when it stops
+	double timeLimit = 0;
+
+	ImageSink sink(&image, preview);
+	RenderLimit limit(timeLimit);
+	RenderQuality quality = QUALITY_NONE;
+	ProgressiveTimes times;
+	ShadowCacheStats shadowStats = { 0, 0 };
+	long long samples = 0;
+	auto render = [&]() {
+		if (progressive || timeLimit > 0)
+			samples = renderProgressive(scene, Vec3<Scalar>(cameraPosition.cast<Scalar>()), imageWidth, imageHeight, supersampling, adaptive, depth,
+				traceMode, threads, &sink, &limit, &quality, &times, &shadowStats);
+		else
+			samples = renderImage(scene, Vec3<Scalar>(cameraPosition.cast<Scalar>()), imageWidth, imageHeight, supersampling, adaptive, depth,
+				traceMode, threads, &sink, &limit, &shadowStats);
+	};
+
+	if (preview == NULL) {
+		render();
+	}
+	else {
+		//traced on another thread, so this one can keep the preview up to date (the window has to stay on this one)
+		atomic<bool> finished(false);
+		thread tracer([&]() {
+			render();
+			finished = true;
+		});
+
+		while (!finished) {
+			preview->update();
+			this_thread::sleep_for(chrono::milliseconds(30));
 		}
+		tracer.join();
+
+		preview->update();
+		delete preview;
+	}
+	printf("traced %lld samples, %.2f per pixel\n", samples, (double)samples / ((double)imageWidth * imageHeight));
+	if (shadowStats.tests > 0) {
+		printf("shadow cache: %lld of %lld cached occluders still blocked the light (%.1f%%)\n", shadowStats.hits, shadowStats.tests,
+			100.0 * shadowStats.hits / shadowStats.tests);
+	}
+	if (progressive || timeLimit > 0) {
+		for (int pass = 0; pass < (int)quality; pass++)
+			printf("progressive pass %d of %d done after %.3fs\n", pass + 1, times.passes, times.passSeconds[pass]);
+		if ((int)quality < times.passes)
+			printf("progressive pass %d of %d stopped after %.3fs\n", (int)quality + 1, times.passes, times.totalSeconds);
+
+		const char* qualityNames[] = { "nothing", "1/256 of the pixels", "1/64 of the pixels", "1/16 of the pixels", "1/4 of the pixels", "every pixel", "supersampled" };
+		printf("got to %s after %.2fs\n", qualityNames[quality], limit.elapsed());
 	}
 
 	image.save("C:\\Users\\Kevin\\Desktop\\raytracer.png");
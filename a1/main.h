@@ -5,12 +5,17 @@
 #include <vector>
 #include "Ray.h"
 #include "SceneObject.h"
+#include "Scene.h"
 
 using namespace Eigen;
 
+//the precision the image is traced in, float or double (build with -DRAYTRACER_SCALAR=float for a float build)
+#ifndef RAYTRACER_SCALAR
+#define RAYTRACER_SCALAR double
+#endif
+
 namespace RayTracer {
-	std::vector<Intersection*>* getIntersections(std::vector<SceneObject*> objects, Ray* ray, SceneObject* ignore, bool any);
-	Intersection* getClosestIntersection(Vector3d* point, std::vector<Intersection*>* intersections);
+	typedef RAYTRACER_SCALAR Scalar;
 }
 
-#endif
\ No newline at end of file
+#endif